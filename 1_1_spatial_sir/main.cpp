@@ -29,13 +29,18 @@
 #include <cadmium/modeling/dynamic_coupled.hpp>
 #include <cadmium/engine/pdevs_dynamic_runner.hpp>
 #include <cadmium/logger/common_loggers.hpp>
+#include "engine/tick.hpp"
 #include "model/sir_coupled.hpp"
 
 using namespace std;
 using namespace cadmium;
 using namespace cadmium::celldevs;
 
+#ifdef CELLDEVS_TICK_TIME
+using TIME = sim_engine::tick;
+#else
 using TIME = float;
+#endif
 
 /*************** Loggers *******************/
 static ofstream out_messages("../logs/1_1_spatial_sir_outputs.txt");
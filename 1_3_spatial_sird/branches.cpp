@@ -0,0 +1,87 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+#include <iostream>
+#include "engine/options.hpp"
+#include "engine/fork.hpp"
+#include "engine/tick.hpp"
+#include "model/cells/sird_cell.hpp"
+
+using namespace std;
+
+#ifdef CELLDEVS_TICK_TIME
+using TIME = sim_engine::tick;
+#else
+using TIME = float;
+#endif
+
+int main(int argc, char ** argv) {
+    // The variants file goes first. The rest of the arguments are the same as for the simulator
+    sim_engine::run_options options;
+    try {
+        if (argc < 2) {
+            throw std::invalid_argument("variants file is missing");
+        }
+        options = sim_engine::parse_options(argc - 1, argv + 1);
+        if (options.fork_at <= 0 || options.fork_at >= options.sim_time) {
+            throw std::invalid_argument("the fork time must be between 0 and the maximum simulation time");
+        }
+        if (!options.checkpoint_path.empty() || !options.restore_path.empty()) {
+            throw std::invalid_argument("branch studies do not support checkpoints");
+        }
+    } catch (std::invalid_argument const &e) {
+        cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        cout << argv[0] << " VARIANTS.json SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)] --fork-at T [--threads N] [--frozen-vicinity]" << endl;
+        return -1;
+    }
+
+    using lattice = sim_engine::lattice<sird_kernel>;
+    auto scenario = sim_engine::read_json(options.config_path);
+    if (!lattice::compatible(scenario)) {
+        cout << "The scenario cannot be simulated with the dense runner" << endl;
+        return -1;
+    }
+    auto variants = sim_engine::parameter_sets(sim_engine::read_json(argv[1]));
+    ofstream index("../logs/1_3_spatial_sird_branches.txt");
+    for (size_t k = 0; k < variants.size(); ++k) {
+        index << k << " " << variants[k].dump() << endl;
+    }
+    // The common prefix is simulated only once. Then, every branch continues it in its own process
+    auto model = lattice::from_json(scenario);
+    if (options.frozen_vicinity) {
+        model.fold_weights();
+    }
+    ofstream prefix_log("../logs/1_3_spatial_sird_prefix.txt");
+    sim_engine::dense_runner<TIME, sird_kernel> r(std::move(model), prefix_log, 1, sim_engine::schedule::active);
+    r.run_until(options.fork_at);
+    prefix_log.flush();
+    bool success = sim_engine::fork_branches(r, scenario, variants, (TIME) options.sim_time, [](size_t k) {
+        return "../logs/1_3_spatial_sird_branch_" + to_string(k) + ".txt";
+    }, options.threads);
+    return success? 0 : -1;
+}
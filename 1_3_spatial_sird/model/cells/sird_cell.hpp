@@ -29,6 +29,11 @@
 #define CELLDEVS_TUTORIAL_1_3_SPATIAL_SIRD_SIRD_CELL_HPP
 
 #include <cmath>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <memory_resource>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/cell/grid_cell.hpp>
 #include "../state.hpp"
@@ -57,6 +62,102 @@ void from_json(const nlohmann::json& j, sird_cell_config &c) {
     j.at("fatality").get_to(c.fatality);
 }
 
+/**
+ * Side-effect-free version of the sird_cell transition function.
+ * sird_cell delegates to it, and the lattice runners in the engine directory call it directly over flat arrays of cells.
+ */
+struct sird_kernel {
+    using state_type = sird;            /// cell state struct
+    using vicinity_type = mc;           /// cells vicinity struct
+    using config_type = sird_cell_config;  /// cell configuration struct
+    static constexpr const char *cell_type = "sird";  /// cell type as written in the JSON scenario file
+    static constexpr int output_delay = 1;  /// in this example, the delay is always 1 simulation tick.
+
+    /**
+     * Share of the infected people of a neighbor cell that may move to a cell.
+     * Vicinities never change, so the engine may compute it only once per pair of neighbors (see --frozen-vicinity).
+     * Contributions computed from it are not rounded as the ones computed from the vicinity.
+     * @param v vicinity between the cell and its neighbor
+     * @return weight of the neighbor in the new infections of the cell
+     */
+    static float edge_weight(mc const &v) {
+        return v.mobility * v.connectivity;
+    }
+
+    /**
+     * Contribution of one neighbor cell to the new infections of a cell.
+     * @param n latest published state of the neighbor cell
+     * @param weight weight of the neighbor (see edge_weight)
+     * @return infected people that may move from the neighbor cell to the cell
+     */
+    static float neighbor_contribution(sird const &n, float weight) {
+        return n.infected * (float) n.population * weight;
+    }
+
+    /**
+     * Contribution of one neighbor cell to the new infections of a cell.
+     * @param n latest published state of the neighbor cell
+     * @param v vicinity between the cell and its neighbor
+     * @return infected people that may move from the neighbor cell to the cell
+     */
+    static float neighbor_contribution(sird const &n, mc const &v) {
+        return n.infected * (float) n.population * v.mobility * v.connectivity;
+    }
+
+    /**
+     * Computes the state that a cell should have according to its current state and its neighbors' contributions.
+     * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells
+     * @param config configuration parameters of the cell
+     * @return the new state that the cell should have
+     */
+    static sird local_computation(sird const &c_state, float aux, sird_cell_config const &config) {
+        sird res = c_state;  // first, we make a copy of the cell's current state and store it in the variable res
+        float new_i = new_infections(res, aux, config);  // to compute the percentage of new infections, we implement an auxiliary method.
+        float new_r = new_recoveries(res, config);  // to compute the percentage of new recovered people, we implement an auxiliary method
+        float new_d = new_deceases(res, config);      // to compute the percentage of new dead people, we implement an auxiliary method
+
+        // We just want two decimals in the percentage -> let's round the current outcome:
+        res.deceased = std::round((res.deceased + new_d) * 100) / 100;
+        res.recovered = std::round((res.recovered + new_r) * 100) / 100;
+        res.infected = std::round((res.infected + new_i - new_r - new_d) * 100) / 100;
+        res.susceptible = 1 - res.infected - res.recovered - res.deceased;
+        // We return the new state that the cell should have (remember, it is not yet the cell's state)
+        return res;
+    }
+
+    /**
+     * Auxiliary method to compute the percentage of new infections.
+     * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells
+     * @param config configuration parameters of the cell
+     * @return percentage of new infections
+     */
+    static float new_infections(sird const &c_state, float aux, sird_cell_config const &config) {
+        return std::min(c_state.susceptible, c_state.susceptible * config.virulence * aux / (float) c_state.population);
+    }
+
+    /**
+     * Auxiliary method to compute the percentage of new recoveries.
+     * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
+     * @return percentage of new recoveries
+     */
+    static float new_recoveries(sird const &c_state, sird_cell_config const &config) {
+        return c_state.infected * config.recovery;
+    }
+
+    /**
+     * Auxiliary method to compute the percentage of new deceases.
+     * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
+     * @return percentage of new deceases
+     */
+    static float new_deceases(sird const &c_state, sird_cell_config const &config) {
+        return c_state.infected * config.fatality;
+    }
+};
+
 /**
  * Basic Susceptible-Infected-Recovered model for Cadmium Cell-DEVS
  * @tparam T data type used to represent the simulation time
@@ -72,12 +173,34 @@ public:
     using grid_cell<T, sird, mc>::neighbors;
 
     sird_cell_config cell_config;
+    /// Neighbor of the cell: its index in neighbors and its vicinity (vicinities never change)
+    struct neighbor_slot {
+        std::uint32_t index;
+        mc vicinity;
+    };
+    std::shared_ptr<std::pmr::memory_resource> arena;  /// memory of sorted_neighbors (shared by all the cells of the model)
+    std::pmr::vector<neighbor_slot> sorted_neighbors;  /// neighbors sorted by position (i.e., in the order used by the lattice runners)
 
     sird_cell() : grid_cell<T, sird, mc>() {}
 
     [[maybe_unused]] sird_cell(cell_position const &cell_id, cell_unordered<mc> const &neighborhood, sird initial_state,
-                                cell_map<sird, mc> const &map_in, std::string const &delay_id, sird_cell_config config) :
-            grid_cell<T, sird, mc>(cell_id, neighborhood, initial_state, map_in, delay_id), cell_config(config) {
+                                cell_map<sird, mc> const &map_in, std::string const &delay_id, sird_cell_config config,
+                                std::shared_ptr<std::pmr::memory_resource> arena = nullptr) :
+            grid_cell<T, sird, mc>(cell_id, neighborhood, initial_state, map_in, delay_id), cell_config(config),
+            arena(std::move(arena)), sorted_neighbors(memory()) {
+        // Floating-point additions are not associative: we always add up the neighbors' contributions in the same order
+        sorted_neighbors.reserve(neighbors.size());
+        for (std::uint32_t i = 0; i < neighbors.size(); ++i) {
+            sorted_neighbors.push_back({i, state.neighbors_vicinity.at(neighbors[i])});
+        }
+        std::sort(sorted_neighbors.begin(), sorted_neighbors.end(), [this](neighbor_slot const &a, neighbor_slot const &b) {
+            return neighbors[a.index] < neighbors[b.index];
+        });
+    }
+
+    /// @return memory resource of sorted_neighbors (the global heap if the cell was built without an arena)
+    [[nodiscard]] std::pmr::memory_resource *memory() const {
+        return arena? arena.get() : std::pmr::get_default_resource();
     }
 
     /**
@@ -90,18 +213,14 @@ public:
      * @return the new state that the cell should have
      */
     [[nodiscard]] sird local_computation() const override {
-        sird res = state.current_state;  // first, we make a copy of the cell's current state and store it in the variable res
-        float new_i = new_infections(res);  // to compute the percentage of new infections, we implement an auxiliary method.
-        float new_r = new_recoveries(res);  // to compute the percentage of new recovered people, we implement an auxiliary method
-        float new_d = new_deceases(res);      // to compute the percentage of new dead people, we implement an auxiliary method
-
-        // We just want two decimals in the percentage -> let's round the current outcome:
-        res.deceased = std::round((res.deceased + new_d) * 100) / 100;
-        res.recovered = std::round((res.recovered + new_r) * 100) / 100;
-        res.infected = std::round((res.infected + new_i - new_r - new_d) * 100) / 100;
-        res.susceptible = 1 - res.infected - res.recovered - res.deceased;
-        // We return the new state that the cell should have (remember, it is not yet the cell's state)
-        return res;
+        float aux = 0;  // first, we add up the contribution of every neighbor cell to the new infections
+        for (auto const &neighbor: sorted_neighbors) {
+            // Cadmium keeps the neighbor states in a hash map, so each neighbor still costs one lookup
+            sird const &n = state.neighbors_state.at(neighbors[neighbor.index]);
+            aux += sird_kernel::neighbor_contribution(n, neighbor.vicinity);
+        }
+        // the rest of the computation only depends on the cell's current state and configuration
+        return sird_kernel::local_computation(state.current_state, aux, cell_config);
     }
 
     /**
@@ -110,40 +229,7 @@ public:
      * @return how long the cell will wait before sending the new state to neighboring cells.
      */
     T output_delay(sird const &cell_state) const override {
-        return 1;  // in this example, the delay is always 1 simulation tick.
-    }
-
-    /**
-     * Auxiliary method to compute the percentage of new infections. This method MUST be constant. Otherwise, it won't compile
-     * @param c_state current state of the cell
-     * @return percentage of new infections
-     */
-    [[nodiscard]] float new_infections(sird const &c_state) const {
-        float aux = 0;
-        for(auto neighbor: neighbors) {
-            sird n = state.neighbors_state.at(neighbor);
-            mc v = state.neighbors_vicinity.at(neighbor);
-            aux += n.infected * (float) n.population * v.mobility * v.connectivity;
-        }
-        return std::min(c_state.susceptible, c_state.susceptible * cell_config.virulence * aux / (float) c_state.population);
-    }
-
-    /**
-     * Auxiliary method to compute the percentage of new recoveries. This method MUST be constant. Otherwise, it won't compile
-     * @param c_state current state of the cell
-     * @return percentage of new recoveries
-     */
-    [[nodiscard]] float new_recoveries(sird const &c_state) const {
-        return c_state.infected * cell_config.recovery;
-    }
-
-    /**
-     * Auxiliary method to compute the percentage of new deceases. This method MUST be constant. Otherwise, it won't compile
-     * @param c_state current state of the cell
-     * @return percentage of new deceases
-     */
-    [[nodiscard]] float new_deceases(sird const &c_state) const {
-        return c_state.infected * cell_config.fatality;
+        return sird_kernel::output_delay;
     }
 };
 #endif //CELLDEVS_TUTORIAL_1_3_SPATIAL_SIRD_SIRD_CELL_HPP
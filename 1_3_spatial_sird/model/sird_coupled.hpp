@@ -28,6 +28,8 @@
 #ifndef CELLDEVS_TUTORIAL_1_3_SPATIAL_SIRD_COUPLED_HPP
 #define CELLDEVS_TUTORIAL_1_3_SPATIAL_SIRD_COUPLED_HPP
 
+#include <memory>
+#include <memory_resource>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/coupled/grid_coupled.hpp>
 #include "state.hpp"
@@ -40,6 +42,8 @@
  */
 template <typename T>
 class sirds_coupled : public cadmium::celldevs::grid_coupled<T, sird, mc> {
+    /// Memory of the neighbor arrays of all the cells. The cells keep it alive, and it is released at once with the last one
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> arena = std::make_shared<std::pmr::monotonic_buffer_resource>();
 public:
 
     explicit sirds_coupled(std::string const &id) : grid_coupled<T, sird, mc>(id){}
@@ -58,7 +62,7 @@ public:
             // In this first example, we only have one cell type: the sir cell.
             // We only have to call the add_cell method with the corresponding cell type in the template
             auto conf = config.get<sird_cell_config>();
-            this->template add_cell<sird_cell>(map, delay_id, conf);
+            this->template add_cell<sird_cell>(map, delay_id, conf, arena);
         } else throw std::bad_typeid();
     }
 };
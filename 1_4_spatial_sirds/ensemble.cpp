@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <fstream>
+#include <iostream>
+#include "engine/options.hpp"
+#include "engine/ensemble.hpp"
+#include "engine/tick.hpp"
+#include "model/cells/sirds_cell.hpp"
+
+using namespace std;
+
+#ifdef CELLDEVS_TICK_TIME
+using TIME = sim_engine::tick;
+#else
+using TIME = float;
+#endif
+
+int main(int argc, char ** argv) {
+    // The sweep file goes first. The rest of the arguments are the same as for the simulator
+    sim_engine::run_options options;
+    try {
+        if (argc < 2) {
+            throw std::invalid_argument("parameter sweep file is missing");
+        }
+        options = sim_engine::parse_options(argc - 1, argv + 1);
+        if (!options.checkpoint_path.empty() || !options.restore_path.empty()) {
+            throw std::invalid_argument("ensembles do not support checkpoints");
+        }
+    } catch (std::invalid_argument const &e) {
+        cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        cout << argv[0] << " SWEEP.json SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)] [--dense | --hybrid | --lanes] [--frozen-vicinity] [--threads N] [--stop-below EPSILON] [--stop-steady N_TICKS]" << endl;
+        return -1;
+    }
+
+    auto scenario = sim_engine::read_json(options.config_path);
+    if (!sim_engine::lattice<sirds_kernel>::compatible(scenario)) {
+        cout << "The scenario cannot be simulated with the dense runner" << endl;
+        return -1;
+    }
+    auto sets = sim_engine::parameter_sets(sim_engine::read_json(argv[1]));
+    ofstream index("../logs/1_4_spatial_sirds_ensemble.txt");
+    for (size_t k = 0; k < sets.size(); ++k) {
+        index << k << " " << sets[k].dump() << endl;
+    }
+    // Every run writes its own state log. Runs are distributed among the threads
+    sim_engine::ensemble_runner<TIME, sirds_kernel> ensemble(scenario, options.frozen_vicinity);
+    auto state_log = [](size_t k) {
+        return "../logs/1_4_spatial_sirds_ensemble_" + to_string(k) + ".txt";
+    };
+    auto stop = [&options] {
+        return sim_engine::stop_conditions<sird>(options);
+    };
+    if (options.lanes) {
+        ensemble.run_lanes<sirds_lanes_kernel<8>>(sets, options.sim_time, state_log, options.threads, stop);
+    } else {
+        ensemble.run(sets, options.sim_time, state_log, options.threads,
+                     options.dense? sim_engine::schedule::dense :
+                     options.hybrid? sim_engine::schedule::hybrid : sim_engine::schedule::active, stop);
+    }
+    return 0;
+}
@@ -28,7 +28,13 @@
 #ifndef CELLDEVS_TUTORIAL_1_4_SPATIAL_SIRDS_SIRDS_CELL_HPP
 #define CELLDEVS_TUTORIAL_1_4_SPATIAL_SIRDS_SIRDS_CELL_HPP
 
+#include <array>
 #include <cmath>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <memory_resource>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/cell/grid_cell.hpp>
 #include "../state.hpp"
@@ -60,43 +66,65 @@ void from_json(const nlohmann::json& j, sirds_cell_config &c) {
 }
 
 /**
- * Basic Susceptible-Infected-Recovered model for Cadmium Cell-DEVS
- * @tparam T data type used to represent the simulation time
+ * Side-effect-free version of the sirds_cell transition function.
+ * sirds_cell delegates to it, and the lattice runners in the engine directory call it directly over flat arrays of cells.
  */
-template <typename T>
-/// sirds_cell inherits the grid_cell class. As specified by the template, cell state uses the sir struct, and vicinities the mc struct
-class [[maybe_unused]] sirds_cell : public grid_cell<T, sird, mc> {
-public:
-    // We must specify which attributes of the base class we are going to use
-    using grid_cell<T, sird, mc>::simulation_clock;
-    using grid_cell<T, sird, mc>::state;
-    using grid_cell<T, sird, mc>::map;
-    using grid_cell<T, sird, mc>::neighbors;
+struct sirds_kernel {
+    using state_type = sird;            /// cell state struct
+    using vicinity_type = mc;           /// cells vicinity struct
+    using config_type = sirds_cell_config;  /// cell configuration struct
+    using state_arrays = sird_arrays;   /// structure of arrays for the states of many cells (see sim_engine::soa_runner)
+    static constexpr const char *cell_type = "sirds";  /// cell type as written in the JSON scenario file
+    static constexpr int output_delay = 1;  /// in this example, the delay is always 1 simulation tick.
 
-    sirds_cell_config cell_config;
+    /**
+     * Share of the infected people of a neighbor cell that may move to a cell.
+     * Vicinities never change, so the engine may compute it only once per pair of neighbors (see --frozen-vicinity).
+     * Contributions computed from it are not rounded as the ones computed from the vicinity.
+     * @param v vicinity between the cell and its neighbor
+     * @return weight of the neighbor in the new infections of the cell
+     */
+    static float edge_weight(mc const &v) {
+        return v.mobility * v.connectivity;
+    }
 
-    sirds_cell() : grid_cell<T, sird, mc>() {}
+    /**
+     * Contribution of one neighbor cell to the new infections of a cell.
+     * @tparam N sird, or sird_view if the states are stored in a structure of arrays
+     * @param n latest published state of the neighbor cell
+     * @param weight weight of the neighbor (see edge_weight)
+     * @return infected people that may move from the neighbor cell to the cell
+     */
+    template <typename N>
+    static float neighbor_contribution(N const &n, float weight) {
+        return n.infected * (float) n.population * weight;
+    }
 
-    [[maybe_unused]] sirds_cell(cell_position const &cell_id, cell_unordered<mc> const &neighborhood, sird initial_state,
-                               cell_map<sird, mc> const &map_in, std::string const &delay_id, sirds_cell_config config) :
-            grid_cell<T, sird, mc>(cell_id, neighborhood, initial_state, map_in, delay_id), cell_config(config) {
+    /**
+     * Contribution of one neighbor cell to the new infections of a cell.
+     * @tparam N sird, or sird_view if the states are stored in a structure of arrays
+     * @param n latest published state of the neighbor cell
+     * @param v vicinity between the cell and its neighbor
+     * @return infected people that may move from the neighbor cell to the cell
+     */
+    template <typename N>
+    static float neighbor_contribution(N const &n, mc const &v) {
+        return n.infected * (float) n.population * v.mobility * v.connectivity;
     }
 
     /**
-     * We have to override the local_computation method to specify how the cell state changes according to our model.
-     * Remember: the local_computation function CANNOT change any attribute of the cell object (it is a constant method)
-     *           the local_computation function must return the state that the cell should have according to its current state and the neighbors' latest published state.
-     * IMPORTANT: this function does not set the new state of the cell. It just says which state should have the cell. The Cadmium simulator will change the state when it applies
-     * IMPORTANT: neighbor cells' state ARE JUST COPIES of their latest published state. You cannot change a neighbor cell state.
-     * IMPORTANT: neighbor cells' latest published state MAY NOT BE the neighbor cells' current state.
+     * Computes the state that a cell should have according to its current state and its neighbors' contributions.
+     * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells
+     * @param config configuration parameters of the cell
      * @return the new state that the cell should have
      */
-    [[nodiscard]] sird local_computation() const override {
-        sird res = state.current_state;  // first, we make a copy of the cell's current state and store it in the variable res
-        float new_i = new_infections(res);  // to compute the percentage of new infections, we implement an auxiliary method.
-        float new_r = new_recoveries(res);  // to compute the percentage of new recovered people, we implement an auxiliary method
-        float new_d = new_deceases(res);      // to compute the percentage of new dead people, we implement an auxiliary method
-        float new_s = new_susceptibles(res);  // to compute the percentage of new susceptible people, we implement an auxiliary method
+    static sird local_computation(sird const &c_state, float aux, sirds_cell_config const &config) {
+        sird res = c_state;  // first, we make a copy of the cell's current state and store it in the variable res
+        float new_i = new_infections(res, aux, config);  // to compute the percentage of new infections, we implement an auxiliary method.
+        float new_r = new_recoveries(res, config);  // to compute the percentage of new recovered people, we implement an auxiliary method
+        float new_d = new_deceases(res, config);      // to compute the percentage of new dead people, we implement an auxiliary method
+        float new_s = new_susceptibles(res, config);  // to compute the percentage of new susceptible people, we implement an auxiliary method
 
         // We just want two decimals in the percentage -> let's round the current outcome:
         res.deceased = std::round((res.deceased + new_d) * 100) / 100;
@@ -108,54 +136,287 @@ public:
     }
 
     /**
-     * We have to override the output_delay function to tell how long we have to wait before sending a copy of the cell state to neighboring cells.
-     * @param cell_state the new cell state.
-     * @return how long the cell will wait before sending the new state to neighboring cells.
-     */
-    T output_delay(sird const &cell_state) const override {
-        return 1;  // in this example, the delay is always 1 simulation tick.
-    }
-
-    /**
-     * Auxiliary method to compute the percentage of new infections. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new infections.
      * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells
+     * @param config configuration parameters of the cell
      * @return percentage of new infections
      */
-    [[nodiscard]] float new_infections(sird const &c_state) const {
-        float aux = 0;
-        for(auto neighbor: neighbors) {
-            sird n = state.neighbors_state.at(neighbor);
-            mc v = state.neighbors_vicinity.at(neighbor);
-            aux += n.infected * (float) n.population * v.mobility * v.connectivity;
-        }
-        return std::min(c_state.susceptible, c_state.susceptible * cell_config.virulence * aux / (float) c_state.population);
+    static float new_infections(sird const &c_state, float aux, sirds_cell_config const &config) {
+        return std::min(c_state.susceptible, c_state.susceptible * config.virulence * aux / (float) c_state.population);
     }
 
     /**
-     * Auxiliary method to compute the percentage of new recoveries. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new recoveries.
      * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
      * @return percentage of new recoveries
      */
-    [[nodiscard]] float new_recoveries(sird const &c_state) const {
-        return c_state.infected * cell_config.recovery;
+    static float new_recoveries(sird const &c_state, sirds_cell_config const &config) {
+        return c_state.infected * config.recovery;
     }
 
     /**
-     * Auxiliary method to compute the percentage of new susceptible people. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new susceptible people.
      * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
      * @return percentage of new susceptible people
      */
-    [[nodiscard]] float new_susceptibles(sird const &c_state) const {
-        return c_state.recovered * (1 - cell_config.immunity);
+    static float new_susceptibles(sird const &c_state, sirds_cell_config const &config) {
+        return c_state.recovered * (1 - config.immunity);
     }
 
     /**
-     * Auxiliary method to compute the percentage of new deceases. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new deceases.
      * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
      * @return percentage of new deceases
      */
-    [[nodiscard]] float new_deceases(sird const &c_state) const {
-        return c_state.infected * cell_config.fatality;
+    static float new_deceases(sird const &c_state, sirds_cell_config const &config) {
+        return c_state.infected * config.fatality;
+    }
+};
+
+/**
+ * Configuration of the cells simulated with sirds_adaptive_kernel.
+ */
+struct sirds_adaptive_config : sirds_cell_config {
+    float tolerance = 0;    /// maximum relative difference between the published and the current infected percentage
+    int max_delay = 4;      /// maximum time that a cell waits before publishing its new state
+};
+
+/**
+ * Reads the configuration of a cell with an adaptive output delay. The tolerance and the maximum delay are optional.
+ * @param j Chunk of JSON file that represents a cell configuration
+ * @param c cell configuration struct to be filled with the configuration shown in the JSON file.
+ */
+void from_json(const nlohmann::json& j, sirds_adaptive_config &c) {
+    from_json(j, static_cast<sirds_cell_config &>(c));
+    c.tolerance = j.value("tolerance", c.tolerance);
+    c.max_delay = j.value("max_delay", c.max_delay);
+}
+
+/**
+ * Version of sirds_kernel with an adaptive output delay. Cells whose infected percentage barely moves away from the
+ * one they published wait longer before publishing their new state, and cells with a fast-moving infected percentage
+ * publish it in the next tick, as in sirds_kernel. As delays are inertial, a cell that keeps changing while its
+ * infected percentage is within the tolerance keeps postponing its output, and publishes as soon as it drifts further.
+ *
+ * Error bound: let I be the new infected percentage of a cell and P the latest one it published (neighbors only read
+ * the infected percentage). The new state is published after d ticks, with d * |I - P| <= tolerance * max(P, 0.01)
+ * whenever d > 1. Otherwise, it is published in the next tick, as in the run with a fixed delay. Thus, the inputs of
+ * every transition are within tolerance / 2 * max(P, 0.01) of the current infected percentages of the neighbors, plus
+ * the one-tick lag that the fixed-delay run also has. With a tolerance of 0, the simulation is the same as the one of
+ * sirds_kernel. The trajectory deviates further because a held state also postpones the transitions that it
+ * would trigger (including the one of the cell itself, which is part of its own neighborhood).
+ */
+struct sirds_adaptive_kernel : sirds_kernel {
+    using config_type = sirds_adaptive_config;
+    static constexpr int lookahead = 1;     /// cells wait at least one tick before publishing their new state
+    static constexpr float quantum = 0.01f; /// percentages are rounded to two decimals
+
+    /**
+     * @param published latest state published by the cell
+     * @param c_state new state of the cell
+     * @param config configuration parameters of the cell
+     * @return tolerance over the relative change of the infected percentage, capped between 1 and max_delay ticks (see
+     * the error bound above)
+     */
+    static int output_delay(sird const &published, sird const &c_state, sirds_adaptive_config const &config) {
+        if (config.tolerance <= 0) {
+            return 1;
+        }
+        float change = std::abs(c_state.infected - published.infected) / std::max(published.infected, quantum);
+        if (change * (float) config.max_delay <= config.tolerance) {
+            return config.max_delay;
+        }
+        return std::max(1, (int) (config.tolerance / change));
+    }
+};
+
+/**
+ * Version of sirds_kernel whose states are stored in fixed point (see packed_sird) when they are stored in arrays.
+ * The transition function is the one of sirds_kernel, so the simulation is exactly the same.
+ */
+struct sirds_packed_kernel : sirds_kernel {
+    using state_arrays = packed_sird_array;     /// packed states of many cells (see sim_engine::soa_runner)
+};
+
+/**
+ * Version of sirds_kernel that computes N scenarios with the same topology at once (e.g., for parameter sweeps).
+ * States and configurations are stored as structures of arrays with one lane per scenario. Every lane runs exactly
+ * the same computation as sirds_kernel, and lanes are processed in simple loops over the arrays of every field that the
+ * compiler can vectorize. Vectorization is not guaranteed: GCC only vectorizes these loops with -O3, and rounding is only
+ * vectorized with SSE4.1 or later (e.g., -march=native) and -fno-trapping-math. None of them changes the results.
+ * @tparam N number of lanes.
+ */
+template <std::size_t N>
+struct sirds_lanes_kernel {
+    /// N cell states (one per lane)
+    struct state_type {
+        unsigned int population[N];
+        float susceptible[N];
+        float infected[N];
+        float recovered[N];
+        float deceased[N];
+    };
+    /// N cell configurations (one per lane)
+    struct config_type {
+        float virulence[N];
+        float recovery[N];
+        float immunity[N];
+        float fatality[N];
+    };
+    using vicinity_type = mc;                       /// cells vicinity struct (shared by all the lanes)
+    using aggregate_type = std::array<float, N>;    /// sum of the neighbor contributions of every lane
+    static constexpr std::size_t lanes = N;         /// number of scenarios computed at once
+    static constexpr int output_delay = sirds_kernel::output_delay;
+
+    static sird lane(state_type const &s, std::size_t k) {
+        return {s.population[k], s.susceptible[k], s.infected[k], s.recovered[k], s.deceased[k]};
+    }
+
+    static void set_lane(state_type &s, std::size_t k, sird const &x) {
+        s.population[k] = x.population;
+        s.susceptible[k] = x.susceptible;
+        s.infected[k] = x.infected;
+        s.recovered[k] = x.recovered;
+        s.deceased[k] = x.deceased;
+    }
+
+    static sirds_cell_config lane(config_type const &c, std::size_t k) {
+        return {c.virulence[k], c.recovery[k], c.immunity[k], c.fatality[k]};
+    }
+
+    static void set_lane(config_type &c, std::size_t k, sirds_cell_config const &x) {
+        c.virulence[k] = x.virulence;
+        c.recovery[k] = x.recovery;
+        c.immunity[k] = x.immunity;
+        c.fatality[k] = x.fatality;
+    }
+
+    /**
+     * Adds the contribution of one neighbor cell to the new infections of every lane of a cell.
+     * @param aux sum of the contributions of the neighbor cells of every lane
+     * @param n latest published state of the neighbor cell
+     * @param v vicinity between the cell and its neighbor
+     */
+    static void add_contribution(aggregate_type &aux, state_type const &n, mc const &v) {
+        for (std::size_t k = 0; k < N; ++k) {  // same operations as sirds_kernel::neighbor_contribution
+            aux[k] += n.infected[k] * (float) n.population[k] * v.mobility * v.connectivity;
+        }
+    }
+
+    /**
+     * Adds the contribution of one neighbor cell to the new infections of every lane of a cell.
+     * @param aux sum of the contributions of the neighbor cells of every lane
+     * @param n latest published state of the neighbor cell
+     * @param weight weight of the neighbor (see sirds_kernel::edge_weight)
+     */
+    static void add_contribution(aggregate_type &aux, state_type const &n, float weight) {
+        for (std::size_t k = 0; k < N; ++k) {
+            aux[k] += n.infected[k] * (float) n.population[k] * weight;
+        }
+    }
+
+    /**
+     * Computes the state that every lane of a cell should have.
+     * It performs the same operations as sirds_kernel::local_computation, one field at a time, so every loop reads and
+     * writes contiguous arrays of floats.
+     * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells of every lane
+     * @param config configuration parameters of every lane of the cell
+     * @return the new state of every lane of the cell
+     */
+    static state_type local_computation(state_type const &c_state, aggregate_type const &aux, config_type const &config) {
+        state_type res = c_state;
+        for (std::size_t k = 0; k < N; ++k) {
+            float s = c_state.susceptible[k];
+            float new_i = std::min(s, s * config.virulence[k] * aux[k] / (float) c_state.population[k]);
+            float new_r = c_state.infected[k] * config.recovery[k];
+            float new_d = c_state.infected[k] * config.fatality[k];
+            float new_s = c_state.recovered[k] * (1 - config.immunity[k]);
+            res.deceased[k] = std::round((c_state.deceased[k] + new_d) * 100) / 100;
+            res.recovered[k] = std::round((c_state.recovered[k] + new_r - new_s) * 100) / 100;
+            res.infected[k] = std::round((c_state.infected[k] + new_i - new_r - new_d) * 100) / 100;
+            res.susceptible[k] = 1 - res.infected[k] - res.recovered[k] - res.deceased[k];
+        }
+        return res;
+    }
+};
+
+/**
+ * Basic Susceptible-Infected-Recovered model for Cadmium Cell-DEVS
+ * @tparam T data type used to represent the simulation time
+ */
+template <typename T>
+/// sirds_cell inherits the grid_cell class. As specified by the template, cell state uses the sir struct, and vicinities the mc struct
+class [[maybe_unused]] sirds_cell : public grid_cell<T, sird, mc> {
+public:
+    // We must specify which attributes of the base class we are going to use
+    using grid_cell<T, sird, mc>::simulation_clock;
+    using grid_cell<T, sird, mc>::state;
+    using grid_cell<T, sird, mc>::map;
+    using grid_cell<T, sird, mc>::neighbors;
+
+    sirds_cell_config cell_config;
+    /// Neighbor of the cell: its index in neighbors and its vicinity (vicinities never change)
+    struct neighbor_slot {
+        std::uint32_t index;
+        mc vicinity;
+    };
+    std::shared_ptr<std::pmr::memory_resource> arena;  /// memory of sorted_neighbors (shared by all the cells of the model)
+    std::pmr::vector<neighbor_slot> sorted_neighbors;  /// neighbors sorted by position (i.e., in the order used by the lattice runners)
+
+    sirds_cell() : grid_cell<T, sird, mc>() {}
+
+    [[maybe_unused]] sirds_cell(cell_position const &cell_id, cell_unordered<mc> const &neighborhood, sird initial_state,
+                               cell_map<sird, mc> const &map_in, std::string const &delay_id, sirds_cell_config config,
+                               std::shared_ptr<std::pmr::memory_resource> arena = nullptr) :
+            grid_cell<T, sird, mc>(cell_id, neighborhood, initial_state, map_in, delay_id), cell_config(config),
+            arena(std::move(arena)), sorted_neighbors(memory()) {
+        // Floating-point additions are not associative: we always add up the neighbors' contributions in the same order
+        sorted_neighbors.reserve(neighbors.size());
+        for (std::uint32_t i = 0; i < neighbors.size(); ++i) {
+            sorted_neighbors.push_back({i, state.neighbors_vicinity.at(neighbors[i])});
+        }
+        std::sort(sorted_neighbors.begin(), sorted_neighbors.end(), [this](neighbor_slot const &a, neighbor_slot const &b) {
+            return neighbors[a.index] < neighbors[b.index];
+        });
+    }
+
+    /// @return memory resource of sorted_neighbors (the global heap if the cell was built without an arena)
+    [[nodiscard]] std::pmr::memory_resource *memory() const {
+        return arena? arena.get() : std::pmr::get_default_resource();
+    }
+
+    /**
+     * We have to override the local_computation method to specify how the cell state changes according to our model.
+     * Remember: the local_computation function CANNOT change any attribute of the cell object (it is a constant method)
+     *           the local_computation function must return the state that the cell should have according to its current state and the neighbors' latest published state.
+     * IMPORTANT: this function does not set the new state of the cell. It just says which state should have the cell. The Cadmium simulator will change the state when it applies
+     * IMPORTANT: neighbor cells' state ARE JUST COPIES of their latest published state. You cannot change a neighbor cell state.
+     * IMPORTANT: neighbor cells' latest published state MAY NOT BE the neighbor cells' current state.
+     * @return the new state that the cell should have
+     */
+    [[nodiscard]] sird local_computation() const override {
+        float aux = 0;  // first, we add up the contribution of every neighbor cell to the new infections
+        for (auto const &neighbor: sorted_neighbors) {
+            // Cadmium keeps the neighbor states in a hash map, so each neighbor still costs one lookup
+            sird const &n = state.neighbors_state.at(neighbors[neighbor.index]);
+            aux += sirds_kernel::neighbor_contribution(n, neighbor.vicinity);
+        }
+        // the rest of the computation only depends on the cell's current state and configuration
+        return sirds_kernel::local_computation(state.current_state, aux, cell_config);
+    }
+
+    /**
+     * We have to override the output_delay function to tell how long we have to wait before sending a copy of the cell state to neighboring cells.
+     * @param cell_state the new cell state.
+     * @return how long the cell will wait before sending the new state to neighboring cells.
+     */
+    T output_delay(sird const &cell_state) const override {
+        return sirds_kernel::output_delay;
     }
 };
 #endif //CELLDEVS_TUTORIAL_1_4_SPATIAL_SIRDS_SIRDS_CELL_HPP
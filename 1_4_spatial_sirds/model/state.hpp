@@ -28,6 +28,11 @@
 #ifndef CELLDEVS_TUTORIAL_1_4_SPATIAL_SIRDS_STATE_HPP
 #define CELLDEVS_TUTORIAL_1_4_SPATIAL_SIRDS_STATE_HPP
 
+#include <array>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
 #include <nlohmann/json.hpp>
 
 /**
@@ -83,4 +88,167 @@ std::ostream &operator << (std::ostream &os, const sird &x) {
     j.at("deceased").get_to(s.deceased);
 }
 
+/**
+ * Read-only view of the state of a cell stored in a sird_arrays container.
+ * It has the same fields as the sird struct, so functions templated on the state type read it as if it was a sird.
+ * Fields are references to the arrays: only the fields actually read are loaded from memory.
+ */
+struct sird_view {
+    unsigned int const &population;
+    float const &susceptible;
+    float const &infected;
+    float const &recovered;
+    float const &deceased;
+
+    operator sird() const {  // NOLINT: views are meant to be implicitly copied into sird structs
+        return {population, susceptible, infected, recovered, deceased};
+    }
+};
+
+/**
+ * States of many cells stored as a structure of arrays: every field of the sird struct has its own contiguous array,
+ * indexed by the cell index (i.e., the linearised cell position in lattices). A sweep that only reads some fields of
+ * the neighbor states (e.g., infected and population) streams these arrays instead of whole sird structs.
+ */
+struct sird_arrays {
+    std::vector<unsigned int> population;   /// number of individuals that live in every cell
+    std::vector<float> susceptible;         /// percentage of susceptible people in every cell
+    std::vector<float> infected;            /// percentage of infected people in every cell
+    std::vector<float> recovered;           /// percentage of recovered people in every cell
+    std::vector<float> deceased;            /// percentage of deceased people in every cell
+
+    sird_arrays() = default;
+
+    explicit sird_arrays(std::vector<sird> const &states) : population(states.size()), susceptible(states.size()),
+            infected(states.size()), recovered(states.size()), deceased(states.size()) {
+        for (std::size_t i = 0; i < states.size(); ++i) {
+            set(i, states[i]);
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return population.size();
+    }
+
+    sird_view operator[](std::size_t i) const {
+        return {population[i], susceptible[i], infected[i], recovered[i], deceased[i]};
+    }
+
+    void set(std::size_t i, sird const &s) {
+        population[i] = s.population;
+        susceptible[i] = s.susceptible;
+        infected[i] = s.infected;
+        recovered[i] = s.recovered;
+        deceased[i] = s.deceased;
+    }
+};
+
+/**
+ * State of a cell in fixed point. The kernels round the infected, recovered, and deceased percentages to two decimals,
+ * so they are stored as integer numbers of hundredths. The susceptible percentage is not stored, as the kernels always
+ * compute it from the other three. A packed state takes 8 bytes instead of the 20 bytes of a sird struct.
+ */
+struct packed_sird {
+    unsigned int population;    /// Number of individuals that live in the cell
+    std::uint8_t infected;      /// Hundredths of people that are infected
+    std::uint8_t recovered;     /// Hundredths of people that already recovered from the disease
+    std::uint8_t deceased;      /// Hundredths of people that deceased due to the disease
+};
+
+/**
+ * States of many cells stored as packed_sird structs. It has the same interface as sird_arrays.
+ * States are unpacked into exactly the same sird structs that were packed: the percentages are the same float values
+ * that the kernels obtain when they round them, and the susceptible percentage is computed as the kernels do.
+ * Thus, the simulation is exactly the same as with unpacked states.
+ */
+struct packed_sird_array {
+    std::vector<packed_sird> cells;     /// packed state of every cell
+
+    /// Float value of every number of hundredths (k / 100, as the kernels compute it after rounding)
+    static constexpr std::array<float, 256> hundredths = [] {
+        std::array<float, 256> res{};
+        for (std::size_t k = 0; k < res.size(); ++k) {
+            res[k] = (float) k / 100;
+        }
+        return res;
+    }();
+
+    packed_sird_array() = default;
+
+    /**
+     * @param states state of every cell.
+     * @throw std::domain_error if any state cannot be packed (see packable).
+     */
+    explicit packed_sird_array(std::vector<sird> const &states) : cells(states.size()) {
+        for (std::size_t i = 0; i < states.size(); ++i) {
+            set(i, states[i]);
+        }
+    }
+
+    [[nodiscard]] std::size_t size() const {
+        return cells.size();
+    }
+
+    sird operator[](std::size_t i) const {
+        return unpack(cells[i]);
+    }
+
+    /**
+     * Overwrites the state of a cell.
+     * @param i index of the cell.
+     * @param s new state of the cell.
+     * @throw std::domain_error if the state cannot be packed (see packable).
+     */
+    void set(std::size_t i, sird const &s) {
+        if (!pack(s, cells[i])) {
+            throw std::domain_error("cell state percentages are not multiples of 0.01");
+        }
+    }
+
+    /**
+     * @param s cell state.
+     * @return true if the state is unpacked into exactly the same values (e.g., all the initial states of a scenario
+     * whose percentages have at most two decimals, and the susceptible percentage is 1 minus the others).
+     */
+    static bool packable(sird const &s) {
+        packed_sird p{};
+        return pack(s, p);
+    }
+
+    static sird unpack(packed_sird const &p) {
+        float infected = hundredths[p.infected];
+        float recovered = hundredths[p.recovered];
+        float deceased = hundredths[p.deceased];
+        return {p.population, 1 - infected - recovered - deceased, infected, recovered, deceased};
+    }
+
+    /**
+     * @param s cell state.
+     * @param p packed state.
+     * @return true if p unpacks into exactly the same values as s (including the sign of zeros).
+     */
+    static bool pack(sird const &s, packed_sird &p) {
+        p.population = s.population;
+        return to_hundredths(s.infected, p.infected) && to_hundredths(s.recovered, p.recovered) &&
+               to_hundredths(s.deceased, p.deceased) && identical(unpack(p).susceptible, s.susceptible);
+    }
+
+    /**
+     * @param x percentage.
+     * @param k number of hundredths of the percentage.
+     * @return true if x is exactly the float value of k hundredths.
+     */
+    static bool to_hundredths(float x, std::uint8_t &k) {
+        if (!(x >= 0 && x <= 2.55f)) {
+            return false;
+        }
+        k = (std::uint8_t) (x * 100 + 0.5f);
+        return identical(hundredths[k], x);
+    }
+
+    static bool identical(float a, float b) {
+        return a == b && std::signbit(a) == std::signbit(b);
+    }
+};
+
 #endif //CELLDEVS_TUTORIAL_1_3_SPATIAL_SIRD_STATE_HPP
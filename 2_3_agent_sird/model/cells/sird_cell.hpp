@@ -28,8 +28,13 @@
 #ifndef CELLDEVS_TUTORIAL_2_3_AGENT_SIRD_SIR_CELL_HPP
 #define CELLDEVS_TUTORIAL_2_3_AGENT_SIRD_SIR_CELL_HPP
 
+#include <algorithm>
 #include <cmath>
 #include <unordered_map>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <memory_resource>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/cell/cell.hpp>
 #include "../state.hpp"
@@ -59,41 +64,59 @@ void from_json(const nlohmann::json& j, sird_cell_config &c) {
 }
 
 /**
- * Basic Susceptible-Infected-Recovered model for Cadmium Cell-DEVS
- * @tparam T data type used to represent the simulation time
+ * Side-effect-free version of the sird_cell transition function.
+ * sird_cell delegates to it, and the runners in the engine directory call it directly over flat arrays of cells.
  */
-template <typename T>
-/// sir_cell inherits the cell class. As specified by the template, cell state uses the sir struct, and vicinities the mc struct
-class [[maybe_unused]] sird_cell : public cell<T, std::string, sird, mc> {
-public:
-    // We must specify which attributes of the base class we are going to use
-    using cell<T, std::string, sird, mc>::simulation_clock;
-    using cell<T, std::string, sird, mc>::state;
-    using cell<T, std::string, sird, mc>::neighbors;
+struct sird_kernel {
+    using state_type = sird;            /// cell state struct
+    using vicinity_type = mc;           /// cells vicinity struct
+    using config_type = sird_cell_config;  /// cell configuration struct
+    static constexpr const char *cell_type = "sird";  /// cell type as written in the JSON scenario file
+    static constexpr int output_delay = 1;  /// in this example, the delay is always 1 simulation tick.
 
-    sird_cell_config config;
+    /**
+     * Share of the infected people of a neighbor cell that may move to a cell.
+     * Vicinities never change, so the engine may compute it only once per pair of neighbors (see --frozen-vicinity).
+     * Contributions computed from it are not rounded as the ones computed from the vicinity.
+     * @param v vicinity between the cell and its neighbor
+     * @return weight of the neighbor in the new infections of the cell
+     */
+    static float edge_weight(mc const &v) {
+        return v.mobility * v.connectivity;
+    }
 
-    sird_cell() : cell<T, sird, mc>() {}
+    /**
+     * Contribution of one neighbor cell to the new infections of a cell.
+     * @param n latest published state of the neighbor cell
+     * @param weight weight of the neighbor (see edge_weight)
+     * @return infected people that may move from the neighbor cell to the cell
+     */
+    static float neighbor_contribution(sird const &n, float weight) {
+        return n.infected * (float) n.population * weight;
+    }
 
-    [[maybe_unused]] sird_cell(std::string const &cell_id, std::unordered_map<std::string, mc> const &neighborhood,
-                              sird initial_state, std::string const &delay_id, sird_cell_config conf) :
-            cell<T, std::string, sird, mc>(cell_id, neighborhood, initial_state, delay_id), config(conf) {
+    /**
+     * Contribution of one neighbor cell to the new infections of a cell.
+     * @param n latest published state of the neighbor cell
+     * @param v vicinity between the cell and its neighbor
+     * @return infected people that may move from the neighbor cell to the cell
+     */
+    static float neighbor_contribution(sird const &n, mc const &v) {
+        return n.infected * (float) n.population * v.mobility * v.connectivity;
     }
 
     /**
-     * We have to override the local_computation method to specify how the cell state changes according to our model.
-     * Remember: the local_computation function CANNOT change any attribute of the cell object (it is a constant method)
-     *           the local_computation function must return the state that the cell should have according to its current state and the neighbors' latest published state.
-     * IMPORTANT: this function does not set the new state of the cell. It just says which state should have the cell. The Cadmium simulator will change the state when it applies
-     * IMPORTANT: neighbor cells' state ARE JUST COPIES of their latest published state. You cannot change a neighbor cell state.
-     * IMPORTANT: neighbor cells' latest published state MAY NOT BE the neighbor cells' current state.
+     * Computes the state that a cell should have according to its current state and its neighbors' contributions.
+     * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells
+     * @param config configuration parameters of the cell
      * @return the new state that the cell should have
      */
-    [[nodiscard]] sird local_computation() const override {
-        sird res = state.current_state;  // first, we make a copy of the cell's current state and store it in the variable res
-        float new_i = new_infections(res);  // to compute the percentage of new infections, we implement an auxiliary method.
-        float new_r = new_recoveries(res);  // to compute the percentage of new recovered people, we implement an auxiliary method
-        float new_d = new_deceases(res);    // to compute the percentage of new deceased people, we implement an auxiliary method
+    static sird local_computation(sird const &c_state, float aux, sird_cell_config const &config) {
+        sird res = c_state;  // first, we make a copy of the cell's current state and store it in the variable res
+        float new_i = new_infections(res, aux, config);  // to compute the percentage of new infections, we implement an auxiliary method.
+        float new_r = new_recoveries(res, config);  // to compute the percentage of new recovered people, we implement an auxiliary method
+        float new_d = new_deceases(res, config);      // to compute the percentage of new dead people, we implement an auxiliary method
 
         // We just want two decimals in the percentage -> let's round the current outcome:
         res.deceased = std::round((res.deceased + new_d) * 100) / 100;
@@ -105,45 +128,108 @@ public:
     }
 
     /**
-     * We have to override the output_delay function to tell how long we have to wait before sending a copy of the cell state to neighboring cells.
-     * @param cell_state the new cell state.
-     * @return how long the cell will wait before sending the new state to neighboring cells.
-     */
-    T output_delay(sird const &cell_state) const override {
-        return 1;  // in this example, the delay is always 1 simulation tick.
-    }
-
-    /**
-     * Auxiliary method to compute the percentage of new infections. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new infections.
      * @param c_state current state of the cell
+     * @param aux sum of the contributions of all the neighbor cells
+     * @param config configuration parameters of the cell
      * @return percentage of new infections
      */
-    [[nodiscard]] float new_infections(sird const &c_state) const {
-        float aux = 0;
-        for(auto neighbor: neighbors) {
-            sird n = state.neighbors_state.at(neighbor);
-            mc v = state.neighbors_vicinity.at(neighbor);
-            aux += n.infected * (float) n.population * v.mobility * v.connectivity;
-        }
+    static float new_infections(sird const &c_state, float aux, sird_cell_config const &config) {
         return std::min(c_state.susceptible, c_state.susceptible * config.virulence * aux / (float) c_state.population);
     }
 
     /**
-     * Auxiliary method to compute the percentage of new recoveries. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new recoveries.
      * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
      * @return percentage of new recoveries
      */
-    [[nodiscard]] float new_recoveries(sird const &c_state) const {
+    static float new_recoveries(sird const &c_state, sird_cell_config const &config) {
         return c_state.infected * config.recovery;
     }
 
     /**
-     * Auxiliary method to compute the percentage of new deceases. This method MUST be constant. Otherwise, it won't compile
+     * Auxiliary method to compute the percentage of new deceases.
      * @param c_state current state of the cell
+     * @param config configuration parameters of the cell
      * @return percentage of new deceases
      */
-    [[nodiscard]] float new_deceases(sird const &c_state) const {
+    static float new_deceases(sird const &c_state, sird_cell_config const &config) {
         return c_state.infected * config.fatality;
     }
 };
+
+/**
+ * Basic Susceptible-Infected-Recovered model for Cadmium Cell-DEVS
+ * @tparam T data type used to represent the simulation time
+ */
+template <typename T>
+/// sir_cell inherits the cell class. As specified by the template, cell state uses the sir struct, and vicinities the mc struct
+class [[maybe_unused]] sird_cell : public cell<T, std::string, sird, mc> {
+public:
+    // We must specify which attributes of the base class we are going to use
+    using cell<T, std::string, sird, mc>::simulation_clock;
+    using cell<T, std::string, sird, mc>::state;
+    using cell<T, std::string, sird, mc>::neighbors;
+
+    sird_cell_config config;
+    /// Neighbor of the cell: its index in neighbors and its vicinity (vicinities never change)
+    struct neighbor_slot {
+        std::uint32_t index;
+        mc vicinity;
+    };
+    std::shared_ptr<std::pmr::memory_resource> arena;  /// memory of sorted_neighbors (shared by all the cells of the model)
+    std::pmr::vector<neighbor_slot> sorted_neighbors;  /// neighbors sorted by ID (i.e., in the order used by the graph runners)
+
+    sird_cell() : cell<T, sird, mc>() {}
+
+    [[maybe_unused]] sird_cell(std::string const &cell_id, std::unordered_map<std::string, mc> const &neighborhood,
+                              sird initial_state, std::string const &delay_id, sird_cell_config conf,
+                              std::shared_ptr<std::pmr::memory_resource> arena = nullptr) :
+            cell<T, std::string, sird, mc>(cell_id, neighborhood, initial_state, delay_id), config(conf),
+            arena(std::move(arena)), sorted_neighbors(memory()) {
+        // Floating-point additions are not associative: we always add up the neighbors' contributions in the same order
+        sorted_neighbors.reserve(neighbors.size());
+        for (std::uint32_t i = 0; i < neighbors.size(); ++i) {
+            sorted_neighbors.push_back({i, state.neighbors_vicinity.at(neighbors[i])});
+        }
+        std::sort(sorted_neighbors.begin(), sorted_neighbors.end(), [this](neighbor_slot const &a, neighbor_slot const &b) {
+            return neighbors[a.index] < neighbors[b.index];
+        });
+    }
+
+    /// @return memory resource of sorted_neighbors (the global heap if the cell was built without an arena)
+    [[nodiscard]] std::pmr::memory_resource *memory() const {
+        return arena? arena.get() : std::pmr::get_default_resource();
+    }
+
+    /**
+     * We have to override the local_computation method to specify how the cell state changes according to our model.
+     * Remember: the local_computation function CANNOT change any attribute of the cell object (it is a constant method)
+     *           the local_computation function must return the state that the cell should have according to its current state and the neighbors' latest published state.
+     * IMPORTANT: this function does not set the new state of the cell. It just says which state should have the cell. The Cadmium simulator will change the state when it applies
+     * IMPORTANT: neighbor cells' state ARE JUST COPIES of their latest published state. You cannot change a neighbor cell state.
+     * IMPORTANT: neighbor cells' latest published state MAY NOT BE the neighbor cells' current state.
+     * @return the new state that the cell should have
+     */
+    [[nodiscard]] sird local_computation() const override {
+        float aux = 0;  // first, we add up the contribution of every neighbor cell to the new infections
+        for (auto const &neighbor: sorted_neighbors) {
+            // Cadmium keeps the neighbor states in a hash map, so each neighbor still costs one lookup
+            sird const &n = state.neighbors_state.at(neighbors[neighbor.index]);
+            aux += sird_kernel::neighbor_contribution(n, neighbor.vicinity);
+        }
+        // the rest of the computation only depends on the cell's current state and configuration
+        return sird_kernel::local_computation(state.current_state, aux, config);
+    }
+
+    /**
+     * We have to override the output_delay function to tell how long we have to wait before sending a copy of the cell state to neighboring cells.
+     * @param cell_state the new cell state.
+     * @return how long the cell will wait before sending the new state to neighboring cells.
+     */
+    T output_delay(sird const &cell_state) const override {
+        return sird_kernel::output_delay;
+    }
+};
 #endif //CELLDEVS_TUTORIAL_2_3_AGENT_SIRD_SIR_CELL_HPP
@@ -29,13 +29,24 @@
 #include <cadmium/modeling/dynamic_coupled.hpp>
 #include <cadmium/engine/pdevs_dynamic_runner.hpp>
 #include <cadmium/logger/common_loggers.hpp>
+#include "engine/options.hpp"
+#include "engine/dense_runner.hpp"
+#include "engine/conservative_runner.hpp"
+#include "engine/optimistic_runner.hpp"
+#include "engine/checkpoint.hpp"
+#include "engine/incremental_runner.hpp"
+#include "engine/tick.hpp"
 #include "model/sird_coupled.hpp"
 
 using namespace std;
 using namespace cadmium;
 using namespace cadmium::celldevs;
 
+#ifdef CELLDEVS_TICK_TIME
+using TIME = sim_engine::tick;
+#else
 using TIME = float;
+#endif
 
 /*************** Loggers *******************/
 static ofstream out_messages("../logs/2_4_agent_sirds_outputs.txt");
@@ -44,7 +55,7 @@ struct oss_sink_messages{
         return out_messages;
     }
 };
-static ofstream out_state("../logs/2_4_agent_sirds_state.txt");
+static ofstream out_state;  // opened in main, once we know whether the run continues an interrupted one
 struct oss_sink_state{
     static ostream& sink(){
         return out_state;
@@ -60,21 +71,76 @@ using logger_top=logger::multilogger<state, log_messages, global_time_mes, globa
 
 
 int main(int argc, char ** argv) {
-    if (argc < 2) {
+    sim_engine::run_options options;
+    try {
+        options = sim_engine::parse_options(argc, argv);
+    } catch (std::invalid_argument const &e) {
         cout << "Program used with wrong parameters. The program must be invoked as follows:";
-        cout << argv[0] << " SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)]" << endl;
+        cout << argv[0] << " SCENARIO_CONFIG.json [MAX_SIMULATION_TIME (default: 500)] [--dense] [--active] [--hybrid] [--blocked] [--conservative] [--optimistic] [--threads N] [--stop-below EPSILON] [--stop-steady N_TICKS] [--checkpoint FILE [--checkpoint-every T]] [--restore FILE] [--history FILE] [--frozen-vicinity]" << endl;
         return -1;
     }
+    // Restored runs continue the state log of the interrupted run instead of overwriting it
+    string const state_log_path = "../logs/2_4_agent_sirds_state.txt";
+    if (options.restore_path.empty()) {
+        out_state.open(state_log_path);
+    }
+
+    if (options.uses_engine()) {
+        // Cells with a constant output delay can skip the PDEVS event queue
+        using graph = sim_engine::graph<sirds_kernel>;
+        if (!options.restore_path.empty()) {
+            // Checkpoints contain the whole scenario, so the scenario file is not read again
+            ifstream checkpoint(options.restore_path, ios::binary);
+            try {
+                auto stop = sim_engine::stop_conditions<sird>(options);
+                auto progress = sim_engine::read_progress(checkpoint, *stop);
+                sim_engine::resume_state_log(out_state, state_log_path, progress.log_offset);
+                sim_engine::dense_runner<TIME, sirds_kernel, graph> r(checkpoint, out_state, options.threads,
+                        sim_engine::selected_schedule(options));
+                sim_engine::run_with_checkpoints(r, options, *stop, out_state, &progress);
+            } catch (std::runtime_error const &e) {
+                cout << "Unable to resume the simulation from " << options.restore_path << ": " << e.what() << endl;
+                return -1;
+            }
+            return 0;
+        }
+        auto scenario = sim_engine::read_json(options.config_path);
+        if (graph::compatible(scenario)) {
+            auto model = graph::from_json(scenario);
+            if (options.frozen_vicinity) {
+                model.fold_weights();  // neighbor contributions are then rounded differently than by the Cadmium cells
+            }
+            if (!options.history_path.empty()) {
+                // Only the cells affected by the differences with the previous run of the history are recomputed
+                sim_engine::run_incremental<TIME, sirds_kernel>(std::move(model), options.history_path,
+                        out_state, (TIME) options.sim_time);
+                return 0;
+            }
+            if (options.optimistic) {
+                sim_engine::optimistic_runner<TIME, sirds_kernel, graph> r(std::move(model), out_state, options.threads);
+                r.run_until(options.sim_time);
+                return 0;
+            }
+            if (options.conservative) {
+                sim_engine::conservative_runner<TIME, sirds_kernel, graph> r(std::move(model), out_state, options.threads);
+                r.run_until(options.sim_time);
+                return 0;
+            }
+            sim_engine::dense_runner<TIME, sirds_kernel, graph> r(std::move(model), out_state, options.threads,
+                    sim_engine::selected_schedule(options));
+            sim_engine::run_with_checkpoints(r, options, *sim_engine::stop_conditions<sird>(options), out_state);
+            return 0;
+        }
+        cout << "The scenario cannot be simulated with the dense runner. Using the Cadmium runner instead" << endl;
+    }
 
     sirds_coupled<TIME> test = sirds_coupled<TIME>("agent_sirds");
-    std::string scenario_config_file_path = argv[1];
-    test.add_cells_json(scenario_config_file_path);
+    test.add_cells_json(options.config_path);
     test.couple_cells();
 
     std::shared_ptr<cadmium::dynamic::modeling::coupled<TIME>> t = std::make_shared<sirds_coupled<TIME>>(test);
 
     cadmium::dynamic::engine::runner<TIME, logger_top> r(t, {0});
-    float sim_time = (argc > 2)? atof(argv[2]) : 500;
-    r.run_until(sim_time);
+    r.run_until(options.sim_time);
     return 0;
 }
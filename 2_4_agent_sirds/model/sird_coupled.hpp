@@ -28,6 +28,8 @@
 #ifndef CELLDEVS_TUTORIAL_2_4_AGENT_SIRDS_COUPLED_HPP
 #define CELLDEVS_TUTORIAL_2_4_AGENT_SIRDS_COUPLED_HPP
 
+#include <memory>
+#include <memory_resource>
 #include <nlohmann/json.hpp>
 #include <cadmium/celldevs/coupled/cells_coupled.hpp>
 #include "state.hpp"
@@ -40,6 +42,8 @@
  */
 template <typename T>
 class sirds_coupled : public cadmium::celldevs::cells_coupled<T, std::string, sird, mc> {
+    /// Memory of the neighbor arrays of all the cells. The cells keep it alive, and it is released at once with the last one
+    std::shared_ptr<std::pmr::monotonic_buffer_resource> arena = std::make_shared<std::pmr::monotonic_buffer_resource>();
 public:
 
     explicit sirds_coupled(std::string const &id) : cells_coupled<T, std::string, sird, mc>(id){}
@@ -61,7 +65,7 @@ public:
             // In this first example, we only have one cell type: the sir cell.
             // We only have to call the add_cell method with the corresponding cell type in the template
             auto conf = config.get<sirds_cell_config>();
-            this->template add_cell<sirds_cell>(cell_id, neighborhood, initial_state, delay_id, conf);
+            this->template add_cell<sirds_cell>(cell_id, neighborhood, initial_state, delay_id, conf, arena);
         } else throw std::bad_typeid();
     }
 };
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_ADJACENCY_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_ADJACENCY_HPP
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+#include <iterator>
+
+namespace sim_engine {
+    /**
+     * Neighbor lists of all the cells of a scenario in compressed sparse row (CSR) format.
+     * The neighbors of all the cells are stored back to back in two contiguous arrays (neighbor indices and vicinities),
+     * and every cell only keeps the offset of its first neighbor. Thus, a sweep over the cells scans the neighbor
+     * arrays linearly instead of following a separately allocated list per cell.
+     * The neighbors of a cell are accessed as a row that behaves as a vector of (neighbor index, vicinity) pairs.
+     * @tparam V cells vicinity struct.
+     */
+    template <typename V>
+    class adjacency {
+        std::vector<std::size_t> offsets = {0};     /// position of the first neighbor of every cell (and the total)
+        std::vector<std::size_t> indices;           /// index of every neighbor, grouped by cell
+        std::vector<V> vicinities;                  /// vicinity of every neighbor, grouped by cell
+    public:
+        /// Neighbors of a cell
+        class row {
+            std::size_t const *index;   /// index of the first neighbor
+            V const *vicinity;          /// vicinity of the first neighbor
+            std::size_t n;              /// number of neighbors
+        public:
+            using value_type = std::pair<std::size_t, V const &>;
+
+            /// Iterator over the neighbors of a row. It yields (neighbor index, vicinity) pairs.
+            class iterator {
+                std::size_t const *index;
+                V const *vicinity;
+            public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = row::value_type;
+                using difference_type = std::ptrdiff_t;
+                using pointer = void;
+                using reference = value_type;
+
+                iterator(std::size_t const *index, V const *vicinity) : index(index), vicinity(vicinity) {}
+
+                value_type operator*() const {
+                    return {*index, *vicinity};
+                }
+
+                iterator &operator++() {
+                    ++index;
+                    ++vicinity;
+                    return *this;
+                }
+
+                bool operator==(iterator const &other) const {
+                    return index == other.index;
+                }
+
+                bool operator!=(iterator const &other) const {
+                    return index != other.index;
+                }
+            };
+
+            row(std::size_t const *index, V const *vicinity, std::size_t n) : index(index), vicinity(vicinity), n(n) {}
+
+            [[nodiscard]] std::size_t size() const {
+                return n;
+            }
+
+            [[nodiscard]] bool empty() const {
+                return n == 0;
+            }
+
+            value_type operator[](std::size_t k) const {
+                return {index[k], vicinity[k]};
+            }
+
+            [[nodiscard]] iterator begin() const {
+                return {index, vicinity};
+            }
+
+            [[nodiscard]] iterator end() const {
+                return {index + n, vicinity + n};
+            }
+
+            /// @return contiguous array with the index of every neighbor
+            [[nodiscard]] std::size_t const *indices() const {
+                return index;
+            }
+
+            /// @return contiguous array with the vicinity of every neighbor
+            [[nodiscard]] V const *vicinities() const {
+                return vicinity;
+            }
+        };
+
+        adjacency() = default;
+
+        /**
+         * Builds the adjacency from its CSR arrays.
+         * @param offsets position of the first neighbor of every cell, followed by the total number of neighbors.
+         * @param indices index of every neighbor, grouped by cell.
+         * @param vicinities vicinity of every neighbor, grouped by cell.
+         */
+        adjacency(std::vector<std::size_t> offsets, std::vector<std::size_t> indices, std::vector<V> vicinities) :
+                offsets(std::move(offsets)), indices(std::move(indices)), vicinities(std::move(vicinities)) {}
+
+        /// @return number of cells
+        [[nodiscard]] std::size_t size() const {
+            return offsets.size() - 1;
+        }
+
+        /// @return total number of neighbors of all the cells (i.e., number of edges)
+        [[nodiscard]] std::size_t edges() const {
+            return indices.size();
+        }
+
+        /**
+         * @param i index of a cell.
+         * @return neighbors of the cell.
+         */
+        row operator[](std::size_t i) const {
+            return {indices.data() + offsets[i], vicinities.data() + offsets[i], offsets[i + 1] - offsets[i]};
+        }
+
+        /**
+         * Neighbors of a cell paired with other per-edge values than their vicinities (e.g., precomputed edge weights).
+         * @tparam W type of the per-edge values.
+         * @param i index of a cell.
+         * @param values value of every neighbor, grouped by cell (i.e., in the same order as neighbor_indices).
+         * @return neighbors of the cell as a row of (neighbor index, value) pairs.
+         */
+        template <typename W>
+        typename adjacency<W>::row with(std::size_t i, std::vector<W> const &values) const {
+            return {indices.data() + offsets[i], values.data() + offsets[i], offsets[i + 1] - offsets[i]};
+        }
+
+        /**
+         * Reserves memory for the cells and neighbors that are going to be added. Scenarios reserve their adjacency
+         * before building it, so the arrays are allocated once instead of keeping two copies of them while they grow.
+         * @param n_cells expected number of cells.
+         * @param n_edges expected number of neighbors of all the cells.
+         */
+        void reserve(std::size_t n_cells, std::size_t n_edges) {
+            offsets.reserve(n_cells + 1);
+            indices.reserve(n_edges);
+            vicinities.reserve(n_edges);
+        }
+
+        /// Adds a cell without neighbors. Neighbors can only be added to the last cell.
+        void add_cell() {
+            offsets.push_back(indices.size());
+        }
+
+        /**
+         * Adds cells without neighbors until there are n cells.
+         * @param n new number of cells. It cannot be lower than the current one.
+         */
+        void resize(std::size_t n) {
+            offsets.resize(n + 1, indices.size());
+        }
+
+        /**
+         * Adds a neighbor to the last cell.
+         * @param neighbor index of the neighbor cell.
+         * @param vicinity vicinity between the last cell and the neighbor.
+         */
+        void add_neighbor(std::size_t neighbor, V const &vicinity) {
+            indices.push_back(neighbor);
+            vicinities.push_back(vicinity);
+            ++offsets.back();
+        }
+
+        /// @return position of the first neighbor of every cell in the CSR arrays, followed by the number of edges
+        [[nodiscard]] std::vector<std::size_t> const &row_offsets() const {
+            return offsets;
+        }
+
+        /// @return index of every neighbor, grouped by cell
+        [[nodiscard]] std::vector<std::size_t> const &neighbor_indices() const {
+            return indices;
+        }
+
+        /// @return vicinity of every neighbor, grouped by cell
+        [[nodiscard]] std::vector<V> const &neighbor_vicinities() const {
+            return vicinities;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_ADJACENCY_HPP
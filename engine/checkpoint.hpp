@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_CHECKPOINT_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_CHECKPOINT_HPP
+
+#include <cstdio>
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+#include <stdexcept>
+#include <algorithm>
+#include "options.hpp"
+#include "termination.hpp"
+#include "serialization.hpp"
+
+namespace sim_engine {
+    /**
+     * Writes a file through a temporary file that then replaces the previous one, so a crash while writing never
+     * leaves a corrupted file behind.
+     * @tparam F function that writes the contents of the file to an output stream.
+     * @param path path of the file.
+     * @param write function that writes the contents of the file.
+     * @throw std::runtime_error if the file cannot be written.
+     */
+    template <typename F>
+    void replace_file(std::string const &path, F &&write) {
+        auto tmp = path + ".tmp";
+        {
+            std::ofstream os(tmp, std::ios::binary);
+            write(os);
+            if (!os.flush()) {
+                throw std::runtime_error("unable to write checkpoint " + tmp);
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("unable to replace checkpoint " + path);
+        }
+    }
+
+    /**
+     * Writes a checkpoint of a runner. The checkpoint replaces the previous one atomically.
+     * @tparam R runner type.
+     * @param runner runner to be saved.
+     * @param path path of the checkpoint file.
+     * @throw std::runtime_error if the checkpoint cannot be written.
+     */
+    template <typename R>
+    void write_checkpoint(R const &runner, std::string const &path) {
+        replace_file(path, [&](std::ostream &os) {
+            runner.save(os);
+        });
+    }
+
+    /// Progress of an interrupted run that its checkpoints keep besides the runner
+    struct run_progress {
+        bool stopped = false;       /// true if the termination predicate was already fulfilled
+        std::uint64_t log_offset = 0;   /// size of the state log when the checkpoint was written
+    };
+
+    /**
+     * Writes a checkpoint of a run: its progress and the state of its termination predicate, followed by the runner.
+     * @tparam R runner type.
+     * @tparam S cell state type.
+     * @param runner runner to be saved.
+     * @param predicate termination predicate of the run.
+     * @param progress progress of the run.
+     * @param path path of the checkpoint file.
+     * @throw std::runtime_error if the checkpoint cannot be written.
+     */
+    template <typename R, typename S>
+    void write_checkpoint(R const &runner, termination<S> const &predicate, run_progress const &progress,
+                          std::string const &path) {
+        replace_file(path, [&](std::ostream &os) {
+            write_header(os, "run checkpoint");
+            write_binary(os, progress.stopped);
+            write_binary(os, progress.log_offset);
+            predicate.save(os);
+            runner.save(os);
+        });
+    }
+
+    /**
+     * Reads the progress of a run from a checkpoint written by write_checkpoint, and restores its termination
+     * predicate. Then, the stream is positioned at the checkpoint of the runner.
+     * @tparam S cell state type.
+     * @param is input stream with the checkpoint.
+     * @param predicate termination predicate of the run. It must be built from the same options as the interrupted one.
+     * @return progress of the interrupted run.
+     * @throw std::runtime_error if the stream does not contain a valid checkpoint or the predicates differ.
+     */
+    template <typename S>
+    run_progress read_progress(std::istream &is, termination<S> &predicate) {
+        run_progress res;
+        check_header(is, "run checkpoint");
+        read_binary(is, res.stopped);
+        read_binary(is, res.log_offset);
+        predicate.load(is);
+        return res;
+    }
+
+    /**
+     * Opens the state log of an interrupted run, so a restored run continues it. The log is cut to the size that it had
+     * when the checkpoint was written: the ticks that the interrupted run simulated after its last checkpoint are
+     * simulated again, and they must not appear twice.
+     * @param log state log stream to be opened.
+     * @param path path of the state log of the interrupted run.
+     * @param offset size of the state log when the checkpoint was written (see run_progress).
+     * @throw std::runtime_error if the state log is missing or shorter than when the checkpoint was written.
+     */
+    void resume_state_log(std::ofstream &log, std::string const &path, std::uint64_t offset) {
+        std::error_code error;
+        auto size = std::filesystem::file_size(path, error);
+        if (error || size < offset) {
+            throw std::runtime_error("the state log " + path + " is shorter than when the checkpoint was written");
+        }
+        std::filesystem::resize_file(path, offset);
+        log.open(path, std::ios::in | std::ios::out);
+        log.seekp(0, std::ios::end);
+        if (!log) {
+            throw std::runtime_error("unable to open the state log " + path);
+        }
+    }
+
+    /**
+     * Runs a simulation until the time selected in the command line or until a termination predicate is fulfilled.
+     * If the user selected a checkpoint file, the runner writes a checkpoint every checkpoint interval and at the end.
+     * Checkpoints keep the state of the predicate, so checkpoints and restored runs stop at the same tick as an
+     * uninterrupted run (e.g., a steady state may span several checkpoint intervals).
+     * @tparam R runner type.
+     * @tparam S cell state type.
+     * @param runner runner to be executed.
+     * @param options options selected by the user.
+     * @param predicate termination predicate.
+     * @param state_log state log of the runner. Checkpoints record its size.
+     * @param restored progress of the interrupted run if the runner was restored from a checkpoint (the predicate must
+     * then be restored too, see read_progress).
+     */
+    template <typename R, typename S>
+    void run_with_checkpoints(R &runner, run_options const &options, termination<S> &predicate, std::ostream &state_log,
+                              run_progress const *restored = nullptr) {
+        using T = decltype(runner.time());
+        run_progress progress;
+        if (restored != nullptr) {
+            progress = *restored;
+        } else {
+            runner.start(predicate);
+        }
+        while (!progress.stopped && runner.time() < (T) options.sim_time) {
+            auto target = (T) options.sim_time;
+            if (!options.checkpoint_path.empty()) {
+                target = std::min(target, (T) (runner.time() + options.checkpoint_every));
+            }
+            progress.stopped = runner.resume_until(target, predicate);
+            if (!options.checkpoint_path.empty()) {
+                if (!state_log.flush() || state_log.tellp() < 0) {
+                    throw std::runtime_error("unable to find the size of the state log");
+                }
+                progress.log_offset = (std::uint64_t) state_log.tellp();
+                write_checkpoint(runner, predicate, progress, options.checkpoint_path);
+            }
+        }
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_CHECKPOINT_HPP
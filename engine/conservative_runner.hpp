@@ -0,0 +1,431 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_CONSERVATIVE_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_CONSERVATIVE_RUNNER_HPP
+
+#include <deque>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <sstream>
+#include <utility>
+#include <ostream>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+#include "graph.hpp"
+#include "lattice.hpp"
+#include "event_list.hpp"
+#include "work_stealing.hpp"
+
+namespace sim_engine {
+    /**
+     * Conservative parallel runner for lattices and agent graphs.
+     * Cells are split in logical processes (LPs) with roughly the same number of edges, and every LP runs on its own
+     * thread with its own event list. LPs only exchange timestamped neighbor states, and never process an event before
+     * they are sure that no other LP will send them an earlier message. A cell that receives a new neighbor state at
+     * time t publishes its new state at t + output_delay or later. Thus, every LP promises its peers that it will not
+     * send anything before its next scheduled output or before the earliest message it may still receive plus the
+     * minimum output delay (the lookahead). These promises are the only synchronization between LPs: there are no
+     * global barriers, and LPs with heterogeneous delays advance as far as their peers' promises allow. An LP that cannot
+     * advance sleeps until it receives a message or the promise of one of its sources advances. The state log is written
+     * during the run: once every LP has logged its transitions before a given time, the lines before it are written.
+     *
+     * The runner follows the Cadmium Cell-DEVS semantics with inertial delays: every cell publishes its initial state at
+     * the initial time, recomputes its state when it receives new neighbor states, and a new state cancels the output
+     * of the previous one if it has not been published yet. The state log is the same as the one of the Cadmium runner.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the scenario.
+     * @tparam M flat scenario representation (lattice or graph).
+     * @tparam E event list of the scheduled outputs of every LP. By default, the timing wheel for integral time types
+     * (e.g., tick) and a search tree otherwise.
+     */
+    template <typename T, typename K, typename M = lattice<K>, typename E = default_event_list<T>>
+    class conservative_runner {
+        using S = typename K::state_type;
+        using A = decltype(K::neighbor_contribution(std::declval<S>(), std::declval<typename K::vicinity_type>()));
+
+        /// New state published by a cell
+        struct message {
+            T time;             /// simulation time at which the state is published
+            std::size_t cell;   /// index of the cell that publishes its state
+            S state;            /// published state
+            bool operator>(message const &other) const {
+                return time > other.time;
+            }
+        };
+
+        /// Logical process: a contiguous range of cells with its own event list
+        struct process {
+            std::size_t first, last;    /// range of cells [first, last) owned by the LP
+            std::vector<std::size_t> sources;   /// LPs that own neighbors of the cells of this LP
+            std::vector<std::size_t> sinks;     /// LPs that have this LP as a source
+            std::unique_ptr<E> outputs;         /// scheduled outputs of the cells of the LP (indexed from first)
+            std::priority_queue<message, std::vector<message>, std::greater<>> inputs;  /// messages to be processed
+            std::unordered_map<std::size_t, S> remote;  /// latest published state of the neighbors owned by other LPs
+            std::mutex inbox_mutex;             /// mutex for the inbox and the wake-ups
+            std::vector<message> inbox;         /// messages sent by other LPs that have not been read yet
+            std::condition_variable wakeup;     /// notified when the LP receives a message or a source promise advances
+            std::uint64_t wakeups = 0;          /// number of notifications received by the LP
+            std::atomic<T> promise;             /// the LP will not send any message with an earlier time
+            std::mutex log_mutex;               /// mutex for the state log of the LP
+            std::deque<std::pair<T, std::string>> log;  /// state log of the cells of the LP that is not written yet
+            std::atomic<T> logged;              /// the LP has logged all its transitions with an earlier time
+        };
+
+        M model;                                /// scenario topology and cell configurations
+        T lookahead;                            /// minimum output delay of the kernel
+        std::vector<S> current;                 /// current state of every cell
+        std::vector<S> published;               /// latest published state of every cell
+        std::vector<std::size_t> owner;         /// LP of every cell
+        std::vector<std::vector<std::size_t>> followers;    /// cells that have each cell in their neighborhood
+        std::vector<std::vector<std::size_t>> targets;      /// LPs other than the owner with followers of each cell
+        std::vector<std::unique_ptr<process>> processes;    /// logical processes
+        std::ostream &state_log;                /// output stream for the state log
+        std::mutex write_mutex;                 /// held by the LP that is writing the state log
+        T clock;                                /// time until which the scenario has been simulated
+
+        static constexpr T never = std::numeric_limits<T>::max();
+
+        /// @return t plus the lookahead (or never if it overflows)
+        T after(T t) const {
+            return (t >= never - lookahead)? never : t + lookahead;
+        }
+
+        /// @return earliest time of the messages that the LP may receive from now on
+        T earliest_input(process const &p) const {
+            T res = p.inputs.empty()? never : p.inputs.top().time;
+            for (auto s: p.sources) {
+                res = std::min(res, processes[s]->promise.load(std::memory_order_acquire));
+            }
+            return res;
+        }
+
+        /**
+         * Moves the messages of the inbox of the LP to its input queue.
+         * @return number of notifications received by the LP so far.
+         */
+        std::uint64_t read_inbox(process &p) {
+            std::lock_guard<std::mutex> lock(p.inbox_mutex);
+            for (auto &m: p.inbox) {
+                p.inputs.push(std::move(m));
+            }
+            p.inbox.clear();
+            return p.wakeups;
+        }
+
+        /// Wakes up the LP if it is waiting for a message or a promise.
+        static void notify(process &q) {
+            {
+                std::lock_guard<std::mutex> lock(q.inbox_mutex);
+                ++q.wakeups;
+            }
+            q.wakeup.notify_one();
+        }
+
+        /// Blocks the LP until it receives a notification after the given number of them.
+        static void wait(process &p, std::uint64_t seen) {
+            std::unique_lock<std::mutex> lock(p.inbox_mutex);
+            p.wakeup.wait(lock, [&p, seen] { return p.wakeups != seen; });
+        }
+
+        /// Publishes the state of the cells of the LP whose output is scheduled at time t.
+        void publish(process &p, T t, std::vector<std::size_t> &touched) {
+            while (p.outputs->front() == t) {
+                auto i = p.first + p.outputs->pop();
+                published[i] = current[i];
+                touched.push_back(i);
+                p.inputs.push({t, i, current[i]});
+                for (auto target: targets[i]) {
+                    auto &q = *processes[target];
+                    {
+                        std::lock_guard<std::mutex> lock(q.inbox_mutex);
+                        q.inbox.push_back({t, i, current[i]});
+                        ++q.wakeups;
+                    }
+                    q.wakeup.notify_one();
+                }
+            }
+        }
+
+        /// Delivers the messages with time t to the cells of the LP, which compute their new state.
+        void receive(process &p, T t, std::vector<std::size_t> &touched) {
+            std::vector<std::size_t> receivers;
+            while (!p.inputs.empty() && p.inputs.top().time == t) {
+                auto const &m = p.inputs.top();
+                if (owner[m.cell] != owner[p.first]) {
+                    p.remote[m.cell] = m.state;
+                }
+                for (auto f: followers[m.cell]) {
+                    if (f >= p.first && f < p.last) {
+                        receivers.push_back(f);
+                    }
+                }
+                p.inputs.pop();
+            }
+            std::sort(receivers.begin(), receivers.end());
+            receivers.erase(std::unique(receivers.begin(), receivers.end()), receivers.end());
+            for (auto i: receivers) {
+                A aux = model.visit_neighbors(i, [&](auto const &row) {
+                    A res = 0;
+                    for (auto const &[neighbor, weight]: row) {
+                        auto const &n = (neighbor >= p.first && neighbor < p.last)? published[neighbor] : p.remote.at(neighbor);
+                        res += K::neighbor_contribution(n, weight);
+                    }
+                    return res;
+                });
+                auto next = K::local_computation(current[i], aux, model.configs[i]);
+                if (next != current[i]) {
+                    current[i] = next;
+                    // inertial delay: the pending output (if any) is replaced by the new one
+                    p.outputs->push(t + kernel_delay<T, K>(published[i], next, model.configs[i]), i - p.first);
+                }
+                touched.push_back(i);
+            }
+        }
+
+        /// Writes the state of the cells involved in the transitions at time t to the log of the LP.
+        void log_states(process &p, T t, std::vector<std::size_t> &touched) {
+            std::sort(touched.begin(), touched.end());
+            touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+            std::ostringstream ss;
+            for (auto i: touched) {
+                ss << "State for model " << model.cell_id(i) << " is " << current[i] << "\n";
+            }
+            {
+                std::lock_guard<std::mutex> lock(p.log_mutex);
+                p.log.emplace_back(t, ss.str());
+            }
+            touched.clear();
+        }
+
+        /**
+         * Writes the state log lines of all the LPs with an earlier time than the given one, merged by time, and removes
+         * them from the logs of the LPs. LPs own contiguous ranges of cells, so they are written in order.
+         * @param safe no LP will log any transition with an earlier time.
+         */
+        void write_log(T safe) {
+            std::vector<std::vector<std::pair<T, std::string>>> lines(processes.size());
+            for (std::size_t k = 0; k < processes.size(); ++k) {
+                auto &p = *processes[k];
+                std::lock_guard<std::mutex> lock(p.log_mutex);
+                while (!p.log.empty() && p.log.front().first < safe) {
+                    lines[k].push_back(std::move(p.log.front()));
+                    p.log.pop_front();
+                }
+            }
+            std::vector<std::size_t> read(processes.size(), 0);
+            while (true) {
+                T t_log = never;
+                for (std::size_t k = 0; k < processes.size(); ++k) {
+                    if (read[k] < lines[k].size()) {
+                        t_log = std::min(t_log, lines[k][read[k]].first);
+                    }
+                }
+                if (t_log == never) {
+                    break;
+                }
+                state_log << t_log << "\n";
+                for (std::size_t k = 0; k < processes.size(); ++k) {
+                    if (read[k] < lines[k].size() && lines[k][read[k]].first == t_log) {
+                        state_log << lines[k][read[k]++].second;
+                    }
+                }
+            }
+        }
+
+        /// Writes the state log lines that no LP can precede anymore, unless another LP is already writing the log.
+        void flush_log() {
+            std::unique_lock<std::mutex> lock(write_mutex, std::try_to_lock);
+            if (!lock.owns_lock()) {
+                return;
+            }
+            T safe = never;
+            for (auto const &q: processes) {
+                safe = std::min(safe, q->logged.load(std::memory_order_acquire));
+            }
+            write_log(safe);
+        }
+
+        /// Updates the promise of the LP to its peers, and wakes them up if it advances.
+        void promise(process &p) {
+            T next_output = p.outputs->front();
+            T value = std::min(next_output, after(earliest_input(p)));
+            T previous = p.promise.exchange(value, std::memory_order_acq_rel);
+            if (value > previous) {
+                for (auto q: p.sinks) {
+                    notify(*processes[q]);
+                }
+            }
+        }
+
+        /// Processes all the events of an LP that are scheduled before the given time.
+        void run_process(process &p, T t_end) {
+            std::vector<std::size_t> touched;   // cells involved in the transitions at time t_log
+            T t_log = never;
+            while (true) {
+                auto seen = read_inbox(p);
+                T next_output = p.outputs->front();
+                T next_input = earliest_input(p);
+                T next_event = std::min(next_output, next_input);
+                bool new_lines = !touched.empty() && next_event > t_log;
+                if (new_lines) {
+                    log_states(p, t_log, touched);
+                }
+                p.logged.store(next_event, std::memory_order_release);
+                if (new_lines) {
+                    flush_log();
+                }
+                if (next_event >= t_end) {
+                    promise(p);
+                    return;
+                }
+                if (next_output <= next_input) {  // all the messages received before the output have been processed
+                    publish(p, next_output, touched);
+                    t_log = next_output;
+                } else if (!p.inputs.empty() && p.inputs.top().time == next_input && safe(p, next_input)) {
+                    read_inbox(p);  // sources may have sent messages with this time since the last read
+                    receive(p, next_input, touched);
+                    t_log = next_input;
+                } else {  // the LP cannot advance until a source sends a message or promises a later time
+                    promise(p);
+                    wait(p, seen);
+                    continue;
+                }
+                promise(p);
+            }
+        }
+
+        /// @return true if every source LP has promised not to send any message with time t or earlier
+        bool safe(process const &p, T t) const {
+            for (auto s: p.sources) {
+                if (processes[s]->promise.load(std::memory_order_acquire) <= t) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    public:
+        /**
+         * Creates a new conservative runner. At the beginning of the simulation, every cell publishes its initial state.
+         * @param model lattice or graph to be simulated.
+         * @param state_log output stream for the state log.
+         * @param n_processes number of logical processes (each of them runs on its own thread).
+         * @param init_time initial simulation time.
+         */
+        conservative_runner(M model, std::ostream &state_log, std::size_t n_processes = 1, T init_time = 0) :
+                model(std::move(model)), lookahead(kernel_lookahead<T, K>()), state_log(state_log), clock(init_time) {
+            auto n = this->model.states.size();
+            current = this->model.states;
+            published = current;
+            followers.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (auto const &neighbor: this->model.neighbors[i]) {
+                    followers[neighbor.first].push_back(i);
+                }
+            }
+            std::vector<std::size_t> all_cells(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                all_cells[i] = i;
+            }
+            owner.resize(n);
+            for (auto const &range: partition_by_edges(this->model.neighbors, all_cells, n_processes)) {
+                auto p = std::make_unique<process>();
+                p->first = range.first;
+                p->last = range.second;
+                p->promise = init_time;
+                p->logged = init_time;
+                p->outputs = std::make_unique<E>(range.second - range.first);
+                for (auto i = range.first; i < range.second; ++i) {
+                    owner[i] = processes.size();
+                    p->outputs->push(init_time, i - range.first);
+                }
+                processes.push_back(std::move(p));
+            }
+            targets.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (auto f: followers[i]) {
+                    if (owner[f] != owner[i]) {
+                        targets[i].push_back(owner[f]);
+                    }
+                }
+                std::sort(targets[i].begin(), targets[i].end());
+                targets[i].erase(std::unique(targets[i].begin(), targets[i].end()), targets[i].end());
+                for (auto t: targets[i]) {
+                    processes[t]->remote.emplace(i, current[i]);
+                    processes[t]->sources.push_back(owner[i]);
+                }
+            }
+            for (std::size_t k = 0; k < processes.size(); ++k) {
+                auto &p = *processes[k];
+                std::sort(p.sources.begin(), p.sources.end());
+                p.sources.erase(std::unique(p.sources.begin(), p.sources.end()), p.sources.end());
+                for (auto s: p.sources) {
+                    processes[s]->sinks.push_back(k);
+                }
+            }
+        }
+
+        /**
+         * Runs the simulation until the given time. Events scheduled at the given time are not processed.
+         * @param t simulation time at which the simulation stops.
+         * @return the given simulation time.
+         */
+        T run_until(T t) {
+            if (processes.empty()) {  // scenario without cells
+                clock = t;
+                return clock;
+            }
+            std::vector<std::thread> threads;
+            for (std::size_t k = 1; k < processes.size(); ++k) {
+                threads.emplace_back([this, k, t] { run_process(*processes[k], t); });
+            }
+            run_process(*processes[0], t);
+            for (auto &thread: threads) {
+                thread.join();
+            }
+            write_log(never);
+            state_log.flush();
+            clock = t;
+            return clock;
+        }
+
+        /// @return current state of every cell of the scenario
+        [[nodiscard]] std::vector<S> const &states() const {
+            return current;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_CONSERVATIVE_RUNNER_HPP
@@ -0,0 +1,760 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_DENSE_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_DENSE_RUNNER_HPP
+
+#include <memory>
+#include <numeric>
+#include <algorithm>
+#include <vector>
+#include <sstream>
+#include <utility>
+#include <type_traits>
+#include <unordered_map>
+#include <istream>
+#include <ostream>
+#include "graph.hpp"
+#include "lattice.hpp"
+#include "options.hpp"
+#include "serialization.hpp"
+#include "termination.hpp"
+#include "thread_pool.hpp"
+#include "work_stealing.hpp"
+
+namespace sim_engine {
+    /// Strategies for selecting the cells that are evaluated at every tick
+    enum class schedule {
+        dense,      /// sweep all the cells of the scenario
+        active,     /// only visit the cells that publish their state and the cells that receive it
+        hybrid,     /// sweep the tiles with many state changes, and only visit the active cells of the rest
+        blocked     /// sweep bands of cells several ticks in a row while they sit in cache
+    };
+
+    /// @return schedule selected with the command line options of the executables
+    schedule selected_schedule(run_options const &options) {
+        if (options.hybrid) {
+            return schedule::hybrid;
+        }
+        if (options.blocked) {
+            return schedule::blocked;
+        }
+        return options.active? schedule::active : schedule::dense;
+    }
+
+    /**
+     * Synchronous runner for lattices and agent graphs whose cells have a constant output delay.
+     * When every cell waits the same time before publishing its state, a Cell-DEVS simulation is a lockstep stencil:
+     * at every tick, the cells that receive a new neighbor state compute their next state, and the cells whose state
+     * changed publish it one delay later. This runner advances the whole lattice tick by tick instead of going through
+     * the PDEVS event queue, and writes the same state log as the Cadmium runner.
+     * Neighbor contributions are accumulated in the order of the neighbor lists of the scenario representation.
+     *
+     * With the dense schedule, every tick is a double-buffered array sweep over all the cells. With the active
+     * schedule, the runner keeps the frontier of cells that published their state, and only visits them and the cells
+     * that follow them. The cost of a tick then scales with the epidemic wavefront instead of with the lattice area.
+     * The hybrid schedule splits the cells in square tiles (chunks of consecutive cells in agent graphs). After every
+     * tick, tiles where many cells published their state are marked as busy. Busy tiles are swept as in the dense
+     * schedule, while the runner only visits the active cells of quiet tiles. Thus, dense urban cores do not pay for
+     * tracking the frontier, and sparse rural areas do not pay for sweeping idle cells.
+     * The blocked schedule is a dense sweep with temporal blocking: it splits the cells in bands of consecutive cells
+     * (i.e., strips of rows of a lattice) and copies every band and the halo of cells that it depends on for the next
+     * ticks into small local buffers. Then, it advances each band several ticks in a row while its buffers sit in cache,
+     * instead of streaming the whole lattice from memory at every tick. Halo cells are computed redundantly by the
+     * bands that share them. Termination predicates are evaluated at every tick, so bands only advance one tick at a
+     * time when there is any.
+     *
+     * Within a tick, cells only read the current states and write their own entry of the back buffer. Thus, the cells
+     * to be visited can be split in ranges that are evaluated in parallel. Ranges hold roughly the same number of edges
+     * and idle threads steal ranges from busy ones, so hub cells with huge neighborhoods do not stall the sweep.
+     * On machines with several NUMA nodes, threads are pinned to CPUs spread across the nodes, and the states and
+     * configurations of the cells of every thread's ranges are moved to the memory of its node.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the lattice. It must have a constant output delay.
+     * @tparam M flat scenario representation (lattice or graph).
+     */
+    template <typename T, typename K, typename M = lattice<K>>
+    class dense_runner {
+        static_assert(has_constant_delay<K>::value, "dense_runner requires a kernel with a constant output delay");
+        using S = typename K::state_type;
+        using C = typename K::config_type;
+        using A = decltype(K::neighbor_contribution(std::declval<S>(), std::declval<typename K::vicinity_type>()));
+
+        static constexpr char publishes = 1;    /// mark of active cells that publish their state in the current tick
+        static constexpr char receives = 2;     /// mark of active cells that receive a new neighbor state
+        static constexpr std::size_t tile_side = 32;    /// number of cells per dimension of every tile (hybrid schedule)
+        static constexpr std::size_t busy_ratio = 8;    /// a tile is busy if 1 / busy_ratio of its cells publish
+
+        std::shared_ptr<M const> model;         /// scenario topology (it may be shared by several runners)
+        std::vector<C> configs;                 /// configuration of every cell
+        std::vector<S> current;                 /// current (and latest published) state of every cell
+        std::vector<S> next;                    /// back buffer for the states computed in the current tick
+        std::vector<char> published;            /// cells that publish their state in the current tick (not vector<bool>: threads write it concurrently)
+        std::vector<char> changed;              /// cells whose state changed in the current tick
+        std::vector<std::size_t> publishers;    /// indices of the cells that publish their state in the current tick
+        std::ostream *state_log;                /// output stream for the state log
+        T clock;                                /// current simulation time
+        schedule mode;                          /// strategy for selecting the cells to be evaluated
+        std::vector<std::vector<std::size_t>> followers;    /// cells that have each cell in their neighborhood
+        std::vector<char> marks;                /// marks of the cells in the active set (only for the active schedule)
+        std::vector<std::size_t> all_cells;     /// indices of all the cells (the sequence visited by the dense schedule)
+        std::vector<std::size_t> active;        /// indices of the cells visited in the current tick (active schedule)
+        std::vector<std::size_t> frontier;      /// active cells of the quiet tiles (hybrid schedule)
+        std::vector<std::vector<cell_range>> tiles;     /// ranges of consecutive cells of every tile (hybrid schedule)
+        std::vector<std::size_t> tile_of;       /// tile of every cell (hybrid schedule)
+        std::vector<std::size_t> tile_cells;    /// number of cells of every tile (hybrid schedule)
+        std::vector<char> busy;                 /// tiles swept as in the dense schedule (hybrid schedule)
+        std::vector<cell_range> runs;           /// ranges of cells of the busy tiles (hybrid schedule)
+        std::unique_ptr<thread_pool> pool;      /// thread pool for evaluating the lattice in parallel (if any)
+        std::unique_ptr<work_stealing> executor;  /// work-stealing executor on top of the thread pool
+        std::vector<cell_range> dense_tasks;    /// ranges of cells with roughly the same number of edges
+        termination<S> *stop = nullptr;         /// termination predicate to be updated with every state change (if any)
+
+        static constexpr std::size_t band_cells = 16384;  /// number of consecutive cells per band (blocked schedule)
+        static constexpr std::size_t block_ticks = 4;     /// number of ticks that bands advance in a row (blocked schedule)
+
+        /// Cells advanced together several ticks in a row by the blocked schedule
+        struct band {
+            cell_range cells;                   /// range of cells of the band
+            std::vector<std::size_t> globals;   /// local cells: the band, and then its halo sorted by distance to it
+            std::vector<std::size_t> extent;    /// number of local cells at distance d or less from the band
+            std::vector<std::size_t> offsets;   /// position of the neighbors of every local cell in locals
+            std::vector<std::size_t> locals;    /// local index of the neighbors of every local cell (in model order)
+        };
+        std::vector<band> bands;                /// bands of the blocked schedule
+
+        /**
+         * Computes the next state of a cell and logs it if it is involved in the current tick.
+         * @param i index of the cell.
+         * @param imminent true if the cell receives a new neighbor state in the current tick.
+         * @param log output stream for the state log.
+         */
+        void evaluate(std::size_t i, bool imminent, std::ostream &log) {
+            next[i] = current[i];
+            changed[i] = false;
+            if (imminent) {
+                A aux = model->visit_neighbors(i, [&](auto const &row) {
+                    A res = 0;
+                    for (auto const &[neighbor, weight]: row) {
+                        res += K::neighbor_contribution(current[neighbor], weight);
+                    }
+                    return res;
+                });
+                next[i] = K::local_computation(current[i], aux, configs[i]);
+                changed[i] = next[i] != current[i];
+            }
+            if (imminent || published[i]) {
+                log << "State for model " << model->cell_id(i) << " is " << next[i] << "\n";
+            }
+        }
+
+        /// @return true if the cell receives a new neighbor state in the current tick
+        bool imminent(std::size_t i) const {
+            if (mode == schedule::active || (mode == schedule::hybrid && !busy[tile_of[i]])) {
+                return marks[i] & receives;
+            }
+            for (auto const &neighbor: model->neighbors[i]) {
+                if (published[neighbor.first]) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * Evaluates a range of the cells visited in the current tick.
+         * @param cells sequence of cells visited in the current tick.
+         * @param range range of positions of the sequence to be evaluated.
+         * @param log output stream for the state log of the cells in the range.
+         */
+        void sweep(std::vector<std::size_t> const &cells, cell_range range, std::ostream &log) {
+            for (auto k = range.first; k < range.second; ++k) {
+                auto i = cells[k];
+                evaluate(i, imminent(i), log);
+            }
+        }
+
+        /**
+         * Evaluates a sequence of cells, in parallel if the runner has a thread pool.
+         * @param cells sequence of cells visited in the current tick.
+         * @param tasks ranges of the sequence with roughly the same number of edges.
+         */
+        void sweep(std::vector<std::size_t> const &cells, std::vector<cell_range> const &tasks) {
+            if (pool == nullptr) {
+                sweep(cells, {0, cells.size()}, *state_log);
+                return;
+            }
+            // Every range logs into its own buffer. Buffers are written in order after the sweep
+            std::vector<std::ostringstream> logs(tasks.size());
+            executor->run(tasks.size(), [&](std::size_t t) {
+                sweep(cells, tasks[t], logs[t]);
+            });
+            for (auto const &log: logs) {
+                *state_log << log.str();
+            }
+        }
+
+        /// Sweeps all the cells and swaps the buffers.
+        void step_dense() {
+            sweep(all_cells, dense_tasks);
+            std::swap(current, next);
+            std::swap(published, changed);
+            publishers.clear();
+            for (auto i: all_cells) {
+                if (published[i]) {
+                    publishers.push_back(i);
+                    if (stop != nullptr) {
+                        stop->update(next[i], current[i]);
+                    }
+                }
+            }
+        }
+
+        /// Visits the cells that publish their state and their followers, and only updates them.
+        void step_active() {
+            active.clear();
+            for (auto p: publishers) {
+                if (!marks[p]) {
+                    active.push_back(p);
+                }
+                marks[p] |= publishes;
+                for (auto f: followers[p]) {
+                    if (!marks[f]) {
+                        active.push_back(f);
+                    }
+                    marks[f] |= receives;
+                }
+            }
+            std::sort(active.begin(), active.end());  // the state log follows the order of the cells
+            sweep_active();
+        }
+
+        /// Sweeps the busy tiles and only visits the cells that publish or receive a new state in the quiet tiles.
+        void step_hybrid() {
+            frontier.clear();
+            for (auto p: publishers) {
+                if (!busy[tile_of[p]]) {
+                    if (!marks[p]) {
+                        frontier.push_back(p);
+                    }
+                    marks[p] |= publishes;
+                }
+                for (auto f: followers[p]) {
+                    if (!busy[tile_of[f]]) {
+                        if (!marks[f]) {
+                            frontier.push_back(f);
+                        }
+                        marks[f] |= receives;
+                    }
+                }
+            }
+            std::sort(frontier.begin(), frontier.end());
+            runs.clear();
+            for (std::size_t k = 0; k < tiles.size(); ++k) {
+                if (busy[k]) {
+                    runs.insert(runs.end(), tiles[k].begin(), tiles[k].end());
+                }
+            }
+            std::sort(runs.begin(), runs.end());
+            // Busy tiles and the frontier of quiet tiles are merged in the order of the cells
+            active.clear();
+            auto it = frontier.begin();
+            for (auto const &[first, last]: runs) {
+                for (; it != frontier.end() && *it < first; ++it) {
+                    active.push_back(*it);
+                }
+                for (auto i = first; i < last; ++i) {
+                    active.push_back(i);
+                }
+            }
+            active.insert(active.end(), it, frontier.end());
+            sweep_active();
+            classify();
+        }
+
+        /// Evaluates the active cells and only updates them.
+        void sweep_active() {
+            std::vector<cell_range> tasks;
+            if (pool != nullptr) {
+                tasks = partition_by_edges(model->neighbors, active, pool->size() * 8);
+            }
+            sweep(active, tasks);
+            publishers.clear();
+            for (auto i: active) {  // only active cells may have changed, so the rest of the buffer is left untouched
+                published[i] = changed[i];
+                if (changed[i]) {
+                    if (stop != nullptr) {
+                        stop->update(current[i], next[i]);
+                    }
+                    current[i] = next[i];
+                    publishers.push_back(i);
+                }
+                marks[i] = 0;
+            }
+        }
+
+        /**
+         * Finds the cells that a band depends on for advancing a number of ticks in a row.
+         * @param cells range of cells of the band.
+         * @param depth number of ticks that the band advances in a row.
+         * @return the band with its halo and the neighborhoods of its local cells.
+         */
+        band make_band(cell_range cells, std::size_t depth) const {
+            band res;
+            res.cells = cells;
+            std::unordered_map<std::size_t, std::size_t> local;
+            for (auto i = cells.first; i < cells.second; ++i) {
+                local.emplace(i, res.globals.size());
+                res.globals.push_back(i);
+            }
+            res.extent.push_back(res.globals.size());
+            for (std::size_t d = 0; d < depth; ++d) {
+                for (auto c = (d == 0)? 0 : res.extent[d - 1]; c < res.extent[d]; ++c) {
+                    for (auto const &neighbor: model->neighbors[res.globals[c]]) {
+                        if (local.emplace(neighbor.first, res.globals.size()).second) {
+                            res.globals.push_back(neighbor.first);
+                        }
+                    }
+                }
+                res.extent.push_back(res.globals.size());
+            }
+            // The outermost ring of the halo is only read, so it does not need neighborhoods
+            res.offsets.push_back(0);
+            for (std::size_t c = 0; c < res.extent[depth - 1]; ++c) {
+                for (auto const &neighbor: model->neighbors[res.globals[c]]) {
+                    res.locals.push_back(local.at(neighbor.first));
+                }
+                res.offsets.push_back(res.locals.size());
+            }
+            return res;
+        }
+
+        /**
+         * Advances a band and its halo several ticks in local buffers, and writes the band to the back buffer.
+         * @param b band to be advanced.
+         * @param n number of ticks (up to block_ticks).
+         * @param logs state log of the band in every tick.
+         */
+        void advance_band(band const &b, std::size_t n, std::vector<std::string> &logs) {
+            auto size = b.globals.size();
+            std::vector<S> local(size), local_next(size);
+            std::vector<char> local_published(size), local_changed(size);
+            for (std::size_t c = 0; c < size; ++c) {
+                local[c] = current[b.globals[c]];
+                local_published[c] = published[b.globals[c]];
+            }
+            auto band_size = b.cells.second - b.cells.first;
+            std::ostringstream log;
+            for (std::size_t l = 0; l < n; ++l) {
+                // The halo shrinks by one ring every tick: farther cells would need states older than the block
+                for (std::size_t c = 0; c < b.extent[n - l - 1]; ++c) {
+                    auto i = b.globals[c];
+                    bool imminent = false;
+                    for (auto j = b.offsets[c]; j < b.offsets[c + 1]; ++j) {
+                        imminent |= local_published[b.locals[j]];
+                    }
+                    local_next[c] = local[c];
+                    local_changed[c] = false;
+                    if (imminent) {
+                        A aux = model->visit_neighbors(i, [&](auto const &row) {
+                            A res = 0;
+                            for (auto j = b.offsets[c]; j < b.offsets[c + 1]; ++j) {
+                                res += K::neighbor_contribution(local[b.locals[j]], row[j - b.offsets[c]].second);
+                            }
+                            return res;
+                        });
+                        local_next[c] = K::local_computation(local[c], aux, configs[i]);
+                        local_changed[c] = local_next[c] != local[c];
+                    }
+                    if (c < band_size && (imminent || local_published[c])) {
+                        log << "State for model " << model->cell_id(i) << " is " << local_next[c] << "\n";
+                    }
+                }
+                logs[l] = log.str();
+                log.str("");
+                std::swap(local, local_next);
+                std::swap(local_published, local_changed);
+            }
+            for (std::size_t c = 0; c < band_size; ++c) {
+                next[b.globals[c]] = local[c];
+                changed[b.globals[c]] = local_published[c];
+            }
+        }
+
+        /**
+         * Advances all the bands several ticks in a row (in parallel if the runner has a thread pool) and swaps buffers.
+         * @param n number of ticks (up to block_ticks).
+         */
+        void step_blocked(std::size_t n) {
+            std::vector<std::vector<std::string>> logs(bands.size(), std::vector<std::string>(n));
+            if (pool == nullptr) {
+                for (std::size_t k = 0; k < bands.size(); ++k) {
+                    advance_band(bands[k], n, logs[k]);
+                }
+            } else {
+                executor->run(bands.size(), [&](std::size_t k) {
+                    advance_band(bands[k], n, logs[k]);
+                });
+            }
+            for (std::size_t l = 0; l < n; ++l) {
+                // As in Cadmium, ticks without any cell involved do not appear in the state log
+                if (std::any_of(logs.begin(), logs.end(), [l](auto const &log) { return !log[l].empty(); })) {
+                    *state_log << clock << std::endl;
+                    for (auto const &log: logs) {
+                        *state_log << log[l];
+                    }
+                }
+                clock += K::output_delay;
+            }
+            std::swap(current, next);
+            std::swap(published, changed);
+            publishers.clear();
+            for (auto i: all_cells) {
+                if (published[i]) {
+                    publishers.push_back(i);
+                    if (stop != nullptr) {  // there is only one tick per block when there is a termination predicate
+                        stop->update(next[i], current[i]);
+                    }
+                }
+            }
+        }
+
+        /// @return number of ticks (up to block_ticks) that begin before the given time
+        std::size_t ticks_before(T t) const {
+            std::size_t res = 0;
+            for (T tick = clock; tick < t && res < block_ticks; tick += K::output_delay) {
+                ++res;
+            }
+            return res;
+        }
+
+        /// Marks the tiles with many cells that publish their state in the next tick as busy.
+        void classify() {
+            std::vector<std::size_t> load(tiles.size(), 0);
+            for (auto p: publishers) {
+                ++load[tile_of[p]];
+            }
+            for (std::size_t k = 0; k < tiles.size(); ++k) {
+                busy[k] = load[k] * busy_ratio >= tile_cells[k];
+            }
+        }
+        /**
+         * Copies a buffer indexed by cell into memory pages allocated by the threads that own the cells in the dense
+         * schedule. With the first-touch policy of Linux, pages end up on the NUMA node of the owner, instead of on
+         * the node of the thread that loaded the scenario.
+         * @param buffer buffer to be moved. Buffers of types that cannot be copied byte by byte are left in place.
+         * @param owned ranges of cells owned by every thread.
+         */
+        template <typename X>
+        void first_touch(std::vector<X> &buffer, std::vector<std::vector<cell_range>> const &owned) {
+            if constexpr (std::is_trivially_copyable_v<X>) {
+                std::vector<X> res(buffer.size());
+                release_pages(res.data(), res.size() * sizeof(X));
+                pool->on_each_thread([&](std::size_t o) {
+                    for (auto const &[first, last]: owned[o]) {
+                        std::copy(buffer.begin() + first, buffer.begin() + last, res.begin() + first);
+                    }
+                });
+                buffer.swap(res);
+            }
+        }
+
+        /// Places the configurations and states of the cells on the NUMA node of the threads that own them.
+        void place() {
+            std::vector<std::vector<cell_range>> owned(pool->size());
+            for (std::size_t t = 0; t < dense_tasks.size(); ++t) {
+                owned[work_stealing::owner_of(t, dense_tasks.size(), pool->size())].push_back(dense_tasks[t]);
+            }
+            first_touch(configs, owned);
+            first_touch(current, owned);
+            first_touch(next, owned);
+            first_touch(published, owned);
+            first_touch(changed, owned);
+        }
+
+        /// Data read from a checkpoint
+        struct snapshot {
+            std::shared_ptr<M const> model;
+            std::vector<C> configs;
+            T clock;
+            std::vector<S> current;
+            std::vector<char> published;
+
+            static snapshot read(std::istream &is) {
+                snapshot res;
+                check_header(is, "dense_runner checkpoint");
+                res.model = std::make_shared<M const>(M::load(is));
+                read_binary(is, res.configs);
+                read_binary(is, res.clock);
+                read_binary(is, res.current);
+                read_binary(is, res.published);
+                return res;
+            }
+        };
+
+        dense_runner(snapshot s, std::ostream &state_log, std::size_t n_threads, schedule mode) :
+                dense_runner(s.model, std::move(s.configs), state_log, n_threads, mode, s.clock) {
+            current = std::move(s.current);
+            next = current;
+            published = std::move(s.published);
+            publishers.clear();
+            for (auto i: all_cells) {
+                if (published[i]) {
+                    publishers.push_back(i);
+                }
+            }
+            if (mode == schedule::hybrid) {
+                classify();
+            }
+            if (pool != nullptr && pool->pinned()) {
+                place();
+            }
+        }
+    public:
+        /**
+         * Creates a new dense runner. At the beginning of the simulation, every cell publishes its initial state.
+         * @param model lattice or graph to be simulated
+         * @param state_log output stream for the state log
+         * @param n_threads number of threads used for evaluating the lattice.
+         * @param mode strategy for selecting the cells to be evaluated at every tick.
+         * @param init_time initial simulation time
+         */
+        dense_runner(M model, std::ostream &state_log, std::size_t n_threads = 1, schedule mode = schedule::dense,
+                     T init_time = 0) : dense_runner(std::make_shared<M const>(std::move(model)), state_log, n_threads,
+                                                     mode, init_time) {}
+
+        /**
+         * Creates a new dense runner that shares the scenario topology with other runners.
+         * @param model lattice or graph to be simulated
+         * @param state_log output stream for the state log
+         * @param n_threads number of threads used for evaluating the lattice.
+         * @param mode strategy for selecting the cells to be evaluated at every tick.
+         * @param init_time initial simulation time
+         */
+        dense_runner(std::shared_ptr<M const> model, std::ostream &state_log, std::size_t n_threads = 1,
+                     schedule mode = schedule::dense, T init_time = 0) :
+                dense_runner(model, model->configs, state_log, n_threads, mode, init_time) {}
+
+        /**
+         * Creates a new dense runner that shares the scenario topology with other runners, but not the configuration
+         * of the cells (e.g., for running a parameter sweep).
+         * @param model lattice or graph to be simulated
+         * @param configs configuration of every cell
+         * @param state_log output stream for the state log
+         * @param n_threads number of threads used for evaluating the lattice.
+         * @param mode strategy for selecting the cells to be evaluated at every tick.
+         * @param init_time initial simulation time
+         */
+        dense_runner(std::shared_ptr<M const> model, std::vector<C> configs, std::ostream &state_log,
+                     std::size_t n_threads = 1, schedule mode = schedule::dense, T init_time = 0) :
+                model(std::move(model)), configs(std::move(configs)), state_log(&state_log), clock(init_time), mode(mode) {
+            current = this->model->states;
+            next = current;
+            published = std::vector<char>(current.size(), true);
+            changed = std::vector<char>(current.size(), false);
+            all_cells.resize(current.size());
+            std::iota(all_cells.begin(), all_cells.end(), 0);
+            publishers = all_cells;
+            followers.resize(current.size());
+            for (std::size_t i = 0; i < current.size(); ++i) {
+                for (auto const &neighbor: this->model->neighbors[i]) {
+                    followers[neighbor.first].push_back(i);
+                }
+            }
+            marks = std::vector<char>(current.size(), 0);
+            if (mode == schedule::hybrid) {
+                tiles = this->model->blocks(tile_side);
+                tile_of.resize(current.size());
+                tile_cells = std::vector<std::size_t>(tiles.size(), 0);
+                for (std::size_t k = 0; k < tiles.size(); ++k) {
+                    for (auto const &[first, last]: tiles[k]) {
+                        std::fill(tile_of.begin() + first, tile_of.begin() + last, k);
+                        tile_cells[k] += last - first;
+                    }
+                }
+                busy = std::vector<char>(tiles.size(), true);
+            }
+            if (mode == schedule::blocked) {
+                for (std::size_t first = 0; first < current.size(); first += band_cells) {
+                    bands.push_back(make_band({first, std::min(first + band_cells, current.size())}, block_ticks));
+                }
+            }
+            if (n_threads > 1) {
+                pool = std::make_unique<thread_pool>(n_threads, numa_spread(n_threads));
+                executor = std::make_unique<work_stealing>(*pool);
+                dense_tasks = partition_by_edges(this->model->neighbors, all_cells, n_threads * 8);
+                if (pool->pinned()) {
+                    place();
+                }
+            }
+        }
+
+        /**
+         * Resumes a simulation from a checkpoint. Checkpoints contain the scenario too, so they are independent of the
+         * JSON scenario file.
+         * @param checkpoint input stream with a checkpoint written by save.
+         * @param state_log output stream for the state log
+         * @param n_threads number of threads used for evaluating the lattice.
+         * @param mode strategy for selecting the cells to be evaluated at every tick.
+         * @throw std::runtime_error if the stream does not contain a valid checkpoint.
+         */
+        dense_runner(std::istream &checkpoint, std::ostream &state_log, std::size_t n_threads = 1,
+                     schedule mode = schedule::dense) :
+                dense_runner(snapshot::read(checkpoint), state_log, n_threads, mode) {}
+
+        /**
+         * Writes a checkpoint with the scenario, the cell configurations, the simulation clock, the current state of
+         * every cell, and the cells that publish their state in the next tick (i.e., the pending outputs).
+         * As cells advance in lockstep, the latest published states of the neighbors are the current states.
+         * @param os output stream for the checkpoint.
+         */
+        void save(std::ostream &os) const {
+            write_header(os, "dense_runner checkpoint");
+            model->save(os);
+            write_binary(os, configs);
+            write_binary(os, clock);
+            write_binary(os, current);
+            write_binary(os, published);
+        }
+
+        /**
+         * Runs the simulation until the given time.
+         * @param t simulation time at which the simulation stops.
+         * @return the time of the next tick.
+         */
+        T run_until(T t) {
+            while (clock < t) {
+                if (mode == schedule::blocked) {
+                    step_blocked(ticks_before(t));
+                } else {
+                    step();
+                }
+            }
+            return clock;
+        }
+
+        /**
+         * Runs the simulation until the given time or until a termination predicate is fulfilled.
+         * The predicate is evaluated at the end of every tick, and it only sees the cells that changed their state.
+         * @param t simulation time at which the simulation stops.
+         * @param predicate termination predicate.
+         * @return the time of the next tick.
+         */
+        T run_until(T t, termination<S> &predicate) {
+            start(predicate);
+            resume_until(t, predicate);
+            return clock;
+        }
+
+        /**
+         * Starts a termination predicate with the current state of every cell.
+         * @param predicate termination predicate.
+         */
+        void start(termination<S> &predicate) const {
+            if (!predicate.never()) {
+                predicate.start(current);
+            }
+        }
+
+        /**
+         * Continues the simulation with a termination predicate that already saw the previous ticks (e.g., the ticks
+         * before a checkpoint), so the predicate is not started over.
+         * @param t simulation time at which the simulation stops.
+         * @param predicate termination predicate (already started or restored).
+         * @return true if the predicate was fulfilled (i.e., the simulation must not continue).
+         */
+        bool resume_until(T t, termination<S> &predicate) {
+            if (predicate.never()) {
+                run_until(t);
+                return false;
+            }
+            stop = &predicate;
+            bool fulfilled = false;
+            while (!fulfilled && clock < t) {
+                step();
+                fulfilled = predicate.done(publishers.size());
+            }
+            stop = nullptr;
+            return fulfilled;
+        }
+
+        /// Advances the lattice one tick.
+        void step() {
+            if (publishers.empty()) {
+                // No cell receives a new neighbor state, so no cell is imminent and Cadmium would not log this tick
+                clock += K::output_delay;
+                return;
+            }
+            if (mode == schedule::blocked) {
+                step_blocked(1);
+                return;
+            }
+            *state_log << clock << std::endl;
+            if (mode == schedule::active) {
+                step_active();
+            } else if (mode == schedule::hybrid) {
+                step_hybrid();
+            } else {
+                step_dense();
+            }
+            clock += K::output_delay;
+        }
+
+        /**
+         * Changes the configuration of the cells from the next tick on (e.g., for simulating an intervention).
+         * @param new_configs new configuration of every cell.
+         */
+        void configure(std::vector<C> new_configs) {
+            configs = std::move(new_configs);
+        }
+
+        /**
+         * Writes the state log of the next ticks to a different output stream.
+         * @param new_state_log output stream for the state log.
+         */
+        void redirect(std::ostream &new_state_log) {
+            state_log = &new_state_log;
+        }
+
+        /// @return number of threads used for evaluating the lattice
+        [[nodiscard]] std::size_t threads() const {
+            return (pool == nullptr)? 1 : pool->size();
+        }
+
+        /// @return time of the next tick
+        [[nodiscard]] T time() const {
+            return clock;
+        }
+
+        /// @return current state of every cell of the lattice
+        [[nodiscard]] std::vector<S> const &states() const {
+            return current;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_DENSE_RUNNER_HPP
@@ -0,0 +1,381 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_DISTRIBUTED_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_DISTRIBUTED_RUNNER_HPP
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <fstream>
+#include <utility>
+#include <ostream>
+#include <iostream>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <type_traits>
+#include <nlohmann/json.hpp>
+#include "lattice.hpp"
+#include "transport.hpp"
+
+namespace sim_engine {
+    /**
+     * Splits the shape of a lattice in a grid of rectangular tiles, one per rank.
+     * The number of tiles along each dimension is chosen to keep the tiles as square as possible.
+     */
+    struct decomposition {
+        std::vector<int> shape;     /// shape of the complete lattice
+        std::vector<int> parts;     /// number of tiles along each dimension
+
+        /**
+         * @param shape shape of the complete lattice.
+         * @param n_ranks number of tiles.
+         * @throw std::invalid_argument if the lattice has not enough cells for the number of tiles.
+         */
+        decomposition(std::vector<int> shape, std::size_t n_ranks) : shape(std::move(shape)) {
+            parts = std::vector<int>(this->shape.size(), 1);
+            std::vector<int> factors;
+            for (int f = 2; n_ranks > 1; ++f) {
+                for (; n_ranks % f == 0; n_ranks /= f) {
+                    factors.insert(factors.begin(), f);  // biggest factors first
+                }
+            }
+            for (auto f: factors) {
+                std::size_t best = 0;
+                for (std::size_t d = 1; d < parts.size(); ++d) {
+                    if (this->shape[d] * parts[best] > this->shape[best] * parts[d]) {
+                        best = d;
+                    }
+                }
+                parts[best] *= f;
+                if (parts[best] > this->shape[best]) {
+                    throw std::invalid_argument("the lattice is too small for the number of ranks");
+                }
+            }
+        }
+
+        /**
+         * @param rank rank of a tile.
+         * @return first corner (included) and opposite corner (excluded) of the tile.
+         */
+        [[nodiscard]] std::pair<std::vector<int>, std::vector<int>> tile(std::size_t rank) const {
+            std::vector<int> from(shape.size()), to(shape.size());
+            for (auto d = shape.size(); d-- > 0;) {
+                auto k = (long) (rank % parts[d]);
+                rank /= parts[d];
+                from[d] = (int) (k * shape[d] / parts[d]);
+                to[d] = (int) ((k + 1) * shape[d] / parts[d]);
+            }
+            return {from, to};
+        }
+
+        /**
+         * @param pos position of a cell.
+         * @return rank of the tile that owns the cell.
+         */
+        [[nodiscard]] std::size_t owner(std::vector<int> const &pos) const {
+            std::size_t res = 0;
+            for (std::size_t d = 0; d < shape.size(); ++d) {
+                res = res * parts[d] + (std::size_t) (((long) (pos[d] + 1) * parts[d] - 1) / shape[d]);
+            }
+            return res;
+        }
+    };
+
+    /**
+     * Runner for lattices split in rectangular tiles, each simulated by a different process.
+     * Every rank only holds the cells of its tile and ghost copies of the neighbor cells of other tiles (the halo).
+     * At the beginning of every tick, ranks exchange the latest state of the cells in the halos of other ranks. Then,
+     * each rank advances its tile with a double-buffered sweep, as the dense runner does. Wrapped lattices exchange
+     * halos across the torus seam too, as the ghost cells of a tile are given by the neighborhood of its cells.
+     * Each rank writes the state log of its own cells, with the time line of every tick (see merge_state_logs).
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the lattice. It must have a constant output delay.
+     */
+    template <typename T, typename K>
+    class distributed_runner {
+        static_assert(has_constant_delay<K>::value, "distributed_runner requires a kernel with a constant output delay");
+        using S = typename K::state_type;
+        using A = decltype(K::neighbor_contribution(std::declval<S>(), std::declval<typename K::vicinity_type>()));
+        static_assert(std::is_trivially_copyable<S>::value, "cell states are sent as raw bytes");
+
+        /// Cells exchanged with another rank at every tick
+        struct halo {
+            std::size_t peer;                   /// rank at the other side of the halo
+            std::vector<std::size_t> cells;     /// local indices of the exchanged cells (in the order of the messages)
+        };
+
+        transport &net;                         /// transport to the other ranks
+        lattice<K> model;                       /// cells of the tile followed by ghost cells
+        std::vector<S> current;                 /// current (and latest published) state of every cell
+        std::vector<S> next;                    /// back buffer for the states computed in the current tick
+        std::vector<char> published;            /// cells that publish their state in the current tick
+        std::vector<char> changed;              /// cells whose state changed in the current tick
+        std::vector<halo> outgoing;             /// cells of the tile that are ghost cells in other ranks
+        std::vector<halo> incoming;             /// ghost cells and the ranks that own them
+        std::ostream &state_log;                /// output stream for the state log of the tile
+        T clock;                                /// current simulation time
+
+        /// Sends the halos of other ranks and receives the ghost cells of this tile.
+        void exchange_halos() {
+            std::vector<std::pair<std::size_t, std::vector<char>>> outbox;
+            for (auto const &h: outgoing) {
+                std::vector<char> msg(h.cells.size() * (1 + sizeof(S)));
+                auto *ptr = msg.data();
+                for (auto i: h.cells) {
+                    *ptr++ = published[i];
+                    std::memcpy(ptr, &current[i], sizeof(S));
+                    ptr += sizeof(S);
+                }
+                outbox.emplace_back(h.peer, std::move(msg));
+            }
+            std::vector<std::size_t> sources;
+            for (auto const &h: incoming) {
+                sources.push_back(h.peer);
+            }
+            auto inbox = net.exchange(outbox, sources);
+            for (std::size_t k = 0; k < incoming.size(); ++k) {
+                auto const *ptr = inbox[k].data();
+                for (auto i: incoming[k].cells) {
+                    published[i] = *ptr++;
+                    std::memcpy(&current[i], ptr, sizeof(S));
+                    ptr += sizeof(S);
+                }
+            }
+        }
+    public:
+        /**
+         * Creates the runner of one rank. All the ranks must create their runner at the same time, as they tell each
+         * other which cells they need from other tiles.
+         * @param j JSON scenario configuration.
+         * @param net transport to the other ranks.
+         * @param state_log output stream for the state log of the tile.
+         * @param init_time initial simulation time.
+         */
+        distributed_runner(nlohmann::json const &j, transport &net, std::ostream &state_log, T init_time = 0) :
+                net(net), state_log(state_log), clock(init_time) {
+            decomposition tiles(j.at("shape").get<std::vector<int>>(), net.size());
+            auto [from, to] = tiles.tile(net.rank());
+            model = lattice<K>::tile(j, from, to);
+            current = model.states;
+            next = current;
+            published = std::vector<char>(current.size(), true);
+            changed = std::vector<char>(current.size(), false);
+
+            // Every rank asks the owners of its ghost cells to send them at every tick
+            std::vector<std::vector<std::size_t>> requests(net.size());
+            for (auto g = model.n_owned; g < model.size(); ++g) {
+                requests[tiles.owner(model.position(model.global(g)))].push_back(g);
+            }
+            std::vector<std::pair<std::size_t, std::vector<char>>> outbox;
+            std::vector<std::size_t> sources;
+            for (std::size_t peer = 0; peer < net.size(); ++peer) {
+                if (peer == net.rank()) {
+                    continue;
+                }
+                std::vector<char> msg(requests[peer].size() * sizeof(std::size_t));
+                for (std::size_t k = 0; k < requests[peer].size(); ++k) {
+                    auto global = model.global(requests[peer][k]);
+                    std::memcpy(msg.data() + k * sizeof(std::size_t), &global, sizeof(std::size_t));
+                }
+                outbox.emplace_back(peer, std::move(msg));
+                sources.push_back(peer);
+                if (!requests[peer].empty()) {
+                    incoming.push_back({peer, requests[peer]});
+                }
+            }
+            auto inbox = net.exchange(outbox, sources);
+            for (std::size_t k = 0; k < sources.size(); ++k) {
+                halo h{sources[k], {}};
+                for (std::size_t offset = 0; offset < inbox[k].size(); offset += sizeof(std::size_t)) {
+                    std::size_t global;
+                    std::memcpy(&global, inbox[k].data() + offset, sizeof(std::size_t));
+                    auto pos = model.position(global);
+                    std::size_t i = 0;
+                    for (std::size_t d = 0; d < pos.size(); ++d) {
+                        i = i * (to[d] - from[d]) + (pos[d] - from[d]);
+                    }
+                    h.cells.push_back(i);
+                }
+                if (!h.cells.empty()) {
+                    outgoing.push_back(std::move(h));
+                }
+            }
+        }
+
+        /**
+         * Runs the simulation until the given time. All the ranks must run until the same time.
+         * @param t simulation time at which the simulation stops.
+         * @return the time of the next tick.
+         */
+        T run_until(T t) {
+            while (clock < t) {
+                step();
+            }
+            return clock;
+        }
+
+        /// Exchanges halos and advances the tile one tick.
+        void step() {
+            exchange_halos();
+            state_log << clock << "\n";
+            for (std::size_t i = 0; i < model.n_owned; ++i) {
+                bool imminent = false;  // only cells that receive a new neighbor state compute their next state
+                for (auto const &neighbor: model.neighbors[i]) {
+                    imminent |= published[neighbor.first];
+                }
+                next[i] = current[i];
+                changed[i] = false;
+                if (imminent) {
+                    A aux = model.visit_neighbors(i, [&](auto const &row) {
+                        A res = 0;
+                        for (auto const &[neighbor, weight]: row) {
+                            res += K::neighbor_contribution(current[neighbor], weight);
+                        }
+                        return res;
+                    });
+                    next[i] = K::local_computation(current[i], aux, model.configs[i]);
+                    changed[i] = next[i] != current[i];
+                }
+                if (imminent || published[i]) {
+                    state_log << "State for model " << model.cell_id(i) << " is " << next[i] << "\n";
+                }
+            }
+            std::swap(current, next);  // ghost cells are overwritten by the next exchange
+            std::swap(published, changed);
+            clock += K::output_delay;
+        }
+
+        /// Folds the vicinities of the tile into edge weights (see lattice::fold_weights).
+        void fold_weights() {
+            model.fold_weights();
+        }
+
+        /// @return lattice with the cells of the tile followed by the ghost cells
+        [[nodiscard]] lattice<K> const &tile() const {
+            return model;
+        }
+
+        /// @return current state of the cells of the tile followed by the ghost cells
+        [[nodiscard]] std::vector<S> const &states() const {
+            return current;
+        }
+    };
+
+    /**
+     * Merges the state logs written by the ranks of a distributed simulation into the state log of the whole lattice.
+     * The result is the same as the state log of the dense runner: the cells of every tick are sorted by position,
+     * and ticks without any cell are skipped.
+     * @param shape shape of the lattice.
+     * @param rank_logs state log of every rank. All of them have the same time lines (see distributed_runner).
+     * @param state_log output stream for the merged state log.
+     */
+    void merge_state_logs(std::vector<int> const &shape, std::vector<std::istream *> const &rank_logs, std::ostream &state_log) {
+        std::string time_line, line;
+        std::vector<std::pair<std::size_t, std::string>> lines;
+        while (std::getline(*rank_logs.at(0), time_line)) {
+            lines.clear();
+            for (std::size_t k = 0; k < rank_logs.size(); ++k) {
+                auto &log = *rank_logs[k];
+                if (k > 0 && !std::getline(log, line)) {
+                    throw std::runtime_error("the state log of rank " + std::to_string(k) + " is incomplete");
+                }
+                while (log.peek() == 'S' && std::getline(log, line)) {  // "State for model (x,y) is ..."
+                    std::size_t index = 0, begin = line.find('(') + 1;
+                    for (std::size_t d = 0; d < shape.size(); ++d) {
+                        std::size_t end;
+                        index = index * shape[d] + (std::size_t) std::stol(line.substr(begin), &end);
+                        begin += end + 1;
+                    }
+                    lines.emplace_back(index, line);
+                }
+            }
+            if (lines.empty()) {
+                continue;
+            }
+            std::sort(lines.begin(), lines.end());
+            state_log << time_line << "\n";
+            for (auto const &entry: lines) {
+                state_log << entry.second << "\n";
+            }
+        }
+    }
+
+    /**
+     * Simulates a lattice with the distributed runner in several processes of the local host.
+     * Every process writes the state log of its tile, and rank 0 merges them into the state log of the whole lattice.
+     * If a process fails, the other ones are killed.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the lattice.
+     * @param scenario JSON scenario configuration.
+     * @param n_ranks number of processes.
+     * @param base_port first localhost port used by the processes (see socket_transport).
+     * @param sim_time simulation time at which the simulation stops.
+     * @param state_log output stream for the merged state log.
+     * @param rank_log returns the path of the state log of each rank given its rank.
+     * @param frozen_vicinity if true, the vicinities of every tile are folded into edge weights.
+     * @return true if all the processes finished successfully (only in rank 0, other ranks exit).
+     */
+    template <typename T, typename K>
+    bool run_distributed(nlohmann::json const &scenario, std::size_t n_ranks, int base_port, T sim_time,
+                         std::ostream &state_log, std::function<std::string(std::size_t)> const &rank_log,
+                         bool frozen_vicinity = false) {
+        auto rank = spawn_ranks(n_ranks);
+        bool success = true;
+        try {
+            std::ofstream log(rank_log(rank));
+            socket_transport net(rank, n_ranks, base_port);
+            distributed_runner<T, K> r(scenario, net, log);
+            if (frozen_vicinity) {
+                r.fold_weights();
+            }
+            r.run_until(sim_time);
+        } catch (std::exception const &e) {  // sockets are already closed, so the peers of this rank fail too
+            std::cerr << "rank " << rank << " failed: " << e.what() << std::endl;
+            success = false;
+        }
+        if (rank > 0) {
+            _exit(success? 0 : 1);  // children must not run the destructors of the parent's objects
+        }
+        if (!wait_ranks(!success)) {
+            return false;
+        }
+        std::vector<std::ifstream> logs;
+        std::vector<std::istream *> rank_logs;
+        for (std::size_t k = 0; k < n_ranks; ++k) {
+            logs.emplace_back(rank_log(k));
+        }
+        for (auto &log: logs) {
+            rank_logs.push_back(&log);
+        }
+        merge_state_logs(scenario.at("shape").get<std::vector<int>>(), rank_logs, state_log);
+        return true;
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_DISTRIBUTED_RUNNER_HPP
@@ -0,0 +1,188 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_ENSEMBLE_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_ENSEMBLE_HPP
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include "dense_runner.hpp"
+#include "lanes_runner.hpp"
+#include "thread_pool.hpp"
+
+namespace sim_engine {
+    /**
+     * Reads the parameter sets of a sweep. A sweep file may contain:
+     *   - an array of objects: every object is a parameter set (e.g., [{"virulence": 0.6}, {"virulence": 0.7}]).
+     *   - an object of arrays: parameter sets are all the combinations of the values of every parameter
+     *     (e.g., {"virulence": [0.6, 0.7], "recovery": [0.3, 0.4]} results in four parameter sets).
+     * @param sweep JSON sweep configuration.
+     * @return parameter sets of the sweep.
+     * @throw std::invalid_argument if the sweep is neither an array nor an object.
+     */
+    std::vector<nlohmann::json> parameter_sets(nlohmann::json const &sweep) {
+        if (sweep.is_array()) {
+            return sweep.get<std::vector<nlohmann::json>>();
+        }
+        if (!sweep.is_object()) {
+            throw std::invalid_argument("parameter sweeps must be an array or an object");
+        }
+        std::vector<nlohmann::json> res = {nlohmann::json::object()};
+        for (auto const &item: sweep.items()) {
+            std::vector<nlohmann::json> combinations;
+            for (auto const &partial: res) {
+                for (auto const &value: item.value()) {
+                    combinations.push_back(partial);
+                    combinations.back()[item.key()] = value;
+                }
+            }
+            res = std::move(combinations);
+        }
+        return res;
+    }
+
+    /**
+     * Overrides the configuration of all the cells of a scenario with a parameter set.
+     * @param j JSON scenario configuration.
+     * @param parameters parameter set (fields of the cell configuration).
+     * @return JSON scenario configuration in which every cell configuration is patched with the parameter set.
+     */
+    nlohmann::json with_parameters(nlohmann::json j, nlohmann::json const &parameters) {
+        for (auto &item: j.at("cells").items()) {
+            if (item.key() == "default" || item.value().contains("config")) {
+                item.value()["config"].merge_patch(parameters);
+            }
+        }
+        return j;
+    }
+
+    /**
+     * Runs a scenario with many parameter sets. The scenario is read and its topology is built only once.
+     * Then, every parameter set only changes the configuration of the cells, and all the runs share the topology.
+     * Runs are distributed among the threads of a pool, and each of them is a sequential dense runner. Alternatively,
+     * runs are packed in groups of N lanes that are simulated in lockstep with a lanes runner.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the scenario. It must have a constant output delay.
+     * @tparam M flat scenario representation (lattice or graph).
+     */
+    template <typename T, typename K, typename M = lattice<K>>
+    class ensemble_runner {
+        nlohmann::json scenario;            /// JSON scenario configuration
+        std::shared_ptr<M const> model;     /// scenario topology shared by all the runs
+    public:
+        /**
+         * @param scenario JSON scenario configuration.
+         * @param frozen_vicinity if true, the runs read edge weights computed once from the vicinities.
+         * @throw std::bad_typeid if a cell type does not correspond to the kernel
+         */
+        explicit ensemble_runner(nlohmann::json scenario, bool frozen_vicinity = false) : scenario(std::move(scenario)) {
+            auto res = M::from_json(this->scenario);
+            if (frozen_vicinity) {
+                res.fold_weights();
+            }
+            model = std::make_shared<M const>(std::move(res));
+        }
+
+        /**
+         * Runs the scenario once per parameter set.
+         * @param sets parameter sets of the sweep.
+         * @param sim_time simulation time at which every run stops.
+         * @param state_log returns the path of the state log of each run given its index.
+         * @param n_threads number of runs that are simulated at the same time.
+         * @param mode strategy for selecting the cells to be evaluated at every tick.
+         * @param stop creates the termination predicate of every run (if any).
+         */
+        void run(std::vector<nlohmann::json> const &sets, T sim_time,
+                 std::function<std::string(std::size_t)> const &state_log, std::size_t n_threads = 1,
+                 schedule mode = schedule::active,
+                 std::function<std::unique_ptr<termination<typename K::state_type>>()> const &stop = {}) const {
+            thread_pool pool(n_threads);
+            pool.parallel_for(sets.size(), [&](std::size_t k) {
+                std::ofstream log(state_log(k));
+                dense_runner<T, K, M> r(model, M::configurations(with_parameters(scenario, sets[k])), log, 1, mode);
+                if (stop) {
+                    r.run_until(sim_time, *stop());
+                } else {
+                    r.run_until(sim_time);
+                }
+            });
+        }
+
+        /**
+         * Runs the scenario once per parameter set, packing N parameter sets in the lanes of every cell.
+         * @tparam L lane kernel of the scenario's kernel.
+         * @param sets parameter sets of the sweep.
+         * @param sim_time simulation time at which every run stops.
+         * @param state_log returns the path of the state log of each run given its index.
+         * @param n_threads number of groups of runs that are simulated at the same time.
+         * @param stop creates the termination predicate of every run (if any).
+         */
+        template <typename L>
+        void run_lanes(std::vector<nlohmann::json> const &sets, T sim_time,
+                       std::function<std::string(std::size_t)> const &state_log, std::size_t n_threads = 1,
+                       std::function<std::unique_ptr<termination<typename K::state_type>>()> const &stop = {}) const {
+            constexpr auto N = L::lanes;
+            thread_pool pool(n_threads);
+            pool.parallel_for((sets.size() + N - 1) / N, [&](std::size_t group) {
+                std::array<std::vector<typename K::config_type>, N> configs;
+                std::array<std::ofstream, N> files;
+                std::ostream unused(nullptr);  // the last group fills its empty lanes with copies of the last run
+                std::array<std::ostream *, N> logs;
+                for (std::size_t k = 0; k < N; ++k) {
+                    auto run = group * N + k;
+                    if (run < sets.size()) {
+                        configs[k] = M::configurations(with_parameters(scenario, sets[run]));
+                        files[k].open(state_log(run));
+                        logs[k] = &files[k];
+                    } else {
+                        configs[k] = configs[k - 1];
+                        logs[k] = &unused;
+                    }
+                }
+                lanes_runner<T, L, M> r(model, configs, logs);
+                if (stop) {
+                    std::array<std::unique_ptr<termination<typename K::state_type>>, N> predicates;
+                    std::array<termination<typename K::state_type> *, N> lane_predicates;
+                    for (std::size_t k = 0; k < N; ++k) {
+                        predicates[k] = stop();
+                        lane_predicates[k] = predicates[k].get();
+                    }
+                    r.run_until(sim_time, lane_predicates);
+                } else {
+                    r.run_until(sim_time);
+                }
+            });
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_ENSEMBLE_HPP
@@ -0,0 +1,261 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_EVENT_LIST_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_EVENT_LIST_HPP
+
+#include <set>
+#include <queue>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <type_traits>
+
+namespace sim_engine {
+    /**
+     * Event list that keeps the scheduled time of a fixed set of items (e.g., the cells of a logical process) in a
+     * balanced search tree. Every item has at most one scheduled event: scheduling an item again replaces its previous
+     * event, as inertial delays do. Insertions, cancellations, and extractions take O(log n) time.
+     * Unlike the timing wheel, events can be scheduled at any time (e.g., when an optimistic runner rolls back).
+     * @tparam T data type used to represent the simulation time.
+     */
+    template <typename T>
+    class ordered_event_list {
+        static constexpr T never = std::numeric_limits<T>::max();
+
+        std::set<std::pair<T, std::size_t>> events;     /// scheduled events sorted by time
+        std::vector<T> due;                             /// scheduled time of every item (never if it has no event)
+    public:
+        /// @param n_items number of items. Items are identified by their index in [0, n_items).
+        explicit ordered_event_list(std::size_t n_items) : due(n_items, never) {}
+
+        [[nodiscard]] bool empty() const {
+            return events.empty();
+        }
+
+        /// @return time of the earliest scheduled event (never if the list is empty).
+        T front() {
+            return events.empty()? never : events.begin()->first;
+        }
+
+        /**
+         * @param item index of an item.
+         * @return time of the scheduled event of the item (never if it has no event).
+         */
+        [[nodiscard]] T scheduled(std::size_t item) const {
+            return due[item];
+        }
+
+        /**
+         * Schedules an event for an item. If the item had a scheduled event, it is cancelled.
+         * @param t time of the event.
+         * @param item index of the item.
+         */
+        void push(T t, std::size_t item) {
+            erase(item);
+            due[item] = t;
+            events.emplace(t, item);
+        }
+
+        /**
+         * Cancels the scheduled event of an item (if any).
+         * @param item index of the item.
+         */
+        void erase(std::size_t item) {
+            if (due[item] != never) {
+                events.erase({due[item], item});
+                due[item] = never;
+            }
+        }
+
+        /**
+         * Removes one of the earliest scheduled events. The list must not be empty.
+         * @return index of the item of the removed event.
+         */
+        std::size_t pop() {
+            auto item = events.begin()->second;
+            events.erase(events.begin());
+            due[item] = never;
+            return item;
+        }
+    };
+
+    /**
+     * Event list for integral simulation times (a timing wheel).
+     * The wheel has one bucket per tick for the next n_buckets ticks, and events scheduled further away wait in an
+     * overflow heap until the wheel reaches them. When all the delays are integers shorter than the wheel, insertions
+     * and extractions take O(1) time. Cancelled events are not searched for: they are left in their bucket and skipped
+     * when the wheel reaches them. It has the same interface as ordered_event_list.
+     * @tparam T data type used to represent the simulation time. Times must be integral and convertible to uint64_t.
+     */
+    template <typename T>
+    class calendar_event_list {
+        static constexpr T never = std::numeric_limits<T>::max();
+        enum class location : char { none, wheel, overflow };
+
+        std::vector<std::vector<std::size_t>> buckets;  /// items scheduled at each of the next ticks (tick % size)
+        std::priority_queue<std::pair<T, std::size_t>, std::vector<std::pair<T, std::size_t>>, std::greater<>> overflow;
+        std::vector<T> due;                             /// scheduled time of every item (never if it has no event)
+        std::vector<location> where;                    /// container that holds the event of every item
+        std::uint64_t now = 0;                          /// first tick of the wheel (time of the latest extraction)
+        std::uint64_t cursor = 0;                       /// no bucket before this tick holds scheduled events
+        std::size_t n_events = 0;                       /// number of scheduled events
+        std::size_t n_wheel = 0;                        /// number of scheduled events in the wheel
+
+        static std::uint64_t index(T t) {
+            return static_cast<std::uint64_t>(t);
+        }
+
+        /// @return the bucket of a tick within the wheel
+        std::vector<std::size_t> &bucket(std::uint64_t tick) {
+            return buckets[tick % buckets.size()];
+        }
+
+        /// Removes the cancelled entries at the end of the bucket of a tick. @return true if an event is left.
+        bool clean(std::uint64_t tick) {
+            auto &b = bucket(tick);
+            while (!b.empty() && (where[b.back()] != location::wheel || index(due[b.back()]) != tick)) {
+                b.pop_back();
+            }
+            return !b.empty();
+        }
+
+        /// @return the earliest event in the overflow heap (cancelled events are discarded on the way)
+        std::pair<T, std::size_t> const &overflow_top() {
+            while (where[overflow.top().second] != location::overflow || due[overflow.top().second] != overflow.top().first) {
+                overflow.pop();
+            }
+            return overflow.top();
+        }
+
+        /// Moves the wheel to a later tick and brings the overflow events that now fall within the wheel.
+        void move_to(std::uint64_t tick) {
+            if (tick >= now + buckets.size()) {  // the wheel only holds cancelled entries
+                for (auto &b: buckets) {
+                    b.clear();
+                }
+            }
+            now = tick;
+            cursor = tick;
+            while (!overflow.empty() && index(overflow.top().first) < now + buckets.size()) {
+                auto [t, item] = overflow.top();
+                overflow.pop();
+                if (where[item] == location::overflow && due[item] == t) {
+                    bucket(index(t)).push_back(item);
+                    where[item] = location::wheel;
+                    ++n_wheel;
+                }
+            }
+        }
+    public:
+        /**
+         * Creates an empty event list. The wheel starts at tick 0, and events scheduled beyond it wait in the overflow
+         * heap until the first extraction moves the wheel to the earliest event (e.g., when resuming at a later time).
+         * @param n_items number of items. Items are identified by their index in [0, n_items).
+         * @param n_buckets number of ticks covered by the wheel. It should exceed the longest output delay.
+         */
+        explicit calendar_event_list(std::size_t n_items, std::size_t n_buckets = 64) :
+                buckets(n_buckets), due(n_items, never), where(n_items, location::none) {}
+
+        [[nodiscard]] bool empty() const {
+            return n_events == 0;
+        }
+
+        /// @return time of the earliest scheduled event (never if the list is empty).
+        T front() {
+            if (n_events == 0) {
+                return never;
+            }
+            if (n_wheel == 0) {
+                return overflow_top().first;
+            }
+            while (!clean(cursor)) {
+                ++cursor;
+            }
+            return due[bucket(cursor).back()];
+        }
+
+        /**
+         * Schedules an event for an item. If the item had a scheduled event, it is cancelled.
+         * @param t time of the event. It cannot be earlier than the time of the latest extracted event.
+         * @param item index of the item.
+         */
+        void push(T t, std::size_t item) {
+            erase(item);
+            due[item] = t;
+            ++n_events;
+            auto tick = index(t);
+            if (tick < now + buckets.size()) {
+                bucket(tick).push_back(item);
+                where[item] = location::wheel;
+                ++n_wheel;
+                cursor = std::min(cursor, tick);
+            } else {
+                overflow.emplace(t, item);
+                where[item] = location::overflow;
+            }
+        }
+
+        /**
+         * Cancels the scheduled event of an item (if any).
+         * @param item index of the item.
+         */
+        void erase(std::size_t item) {
+            if (where[item] == location::wheel) {
+                --n_wheel;
+            }
+            if (where[item] != location::none) {
+                --n_events;
+            }
+            due[item] = never;
+            where[item] = location::none;
+        }
+
+        /**
+         * Removes one of the earliest scheduled events. The list must not be empty.
+         * @return index of the item of the removed event.
+         */
+        std::size_t pop() {
+            move_to(index(front()));
+            clean(now);
+            auto item = bucket(now).back();
+            bucket(now).pop_back();
+            erase(item);
+            return item;
+        }
+    };
+
+    /// Event list used by default: the timing wheel for integral time types and the search tree otherwise.
+    template <typename T>
+    using default_event_list = std::conditional_t<std::numeric_limits<T>::is_integer, calendar_event_list<T>,
+                                                  ordered_event_list<T>>;
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_EVENT_LIST_HPP
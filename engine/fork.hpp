@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_FORK_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_FORK_HPP
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <ostream>
+#include <stdexcept>
+#include <functional>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <nlohmann/json.hpp>
+#include "ensemble.hpp"
+#include "dense_runner.hpp"
+
+namespace sim_engine {
+    /**
+     * Waits until any child process finishes.
+     * @return true if the child process exited successfully.
+     */
+    bool wait_branch() {
+        int status;
+        return waitpid(-1, &status, 0) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+
+    /**
+     * Forks a running simulation into several branches. Every branch is a child process that changes the configuration
+     * of the cells with a parameter set and continues the simulation until the given time.
+     * Children share the memory of the parent copy-on-write: the topology is never written again, and the states of
+     * the cells are only copied for the memory pages that a branch changes. With the active schedule, only the cells
+     * around the epidemic wavefront are written at every tick, so the memory and time of a branch approach the cost of
+     * its divergent suffix.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the scenario.
+     * @tparam M flat scenario representation (lattice or graph).
+     * @param runner runner with the common prefix of all the branches. It must be single-threaded.
+     * @param scenario JSON scenario configuration used for applying the parameter sets.
+     * @param variants parameter set of every branch.
+     * @param sim_time simulation time at which every branch stops.
+     * @param state_log returns the path of the state log of each branch given its index (it only has the suffix).
+     * @param n_parallel maximum number of branches that are simulated at the same time.
+     * @return true if all the branches finished successfully.
+     * @throw std::invalid_argument if the runner uses more than one thread (threads are not forked).
+     * @throw std::runtime_error if the child processes cannot be created.
+     */
+    template <typename T, typename K, typename M>
+    bool fork_branches(dense_runner<T, K, M> &runner, nlohmann::json const &scenario,
+                       std::vector<nlohmann::json> const &variants, T sim_time,
+                       std::function<std::string(std::size_t)> const &state_log, std::size_t n_parallel = 1) {
+        if (runner.threads() > 1) {
+            throw std::invalid_argument("only single-threaded runners can be forked");
+        }
+        bool success = true;
+        std::size_t running = 0;
+        for (std::size_t k = 0; k < variants.size(); ++k) {
+            if (running == n_parallel) {
+                success &= wait_branch();
+                running--;
+            }
+            auto pid = fork();
+            if (pid < 0) {
+                throw std::runtime_error("unable to fork a new branch");
+            }
+            if (pid == 0) {
+                int status = 0;
+                try {
+                    std::ofstream log(state_log(k));
+                    runner.redirect(log);
+                    runner.configure(M::configurations(with_parameters(scenario, variants[k])));
+                    runner.run_until(sim_time);
+                } catch (...) {
+                    status = 1;
+                }
+                _exit(status);  // children must not run the destructors of the parent's objects
+            }
+            running++;
+        }
+        for (; running > 0; running--) {
+            success &= wait_branch();
+        }
+        return success;
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_FORK_HPP
@@ -0,0 +1,236 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_GRAPH_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_GRAPH_HPP
+
+#include <string>
+#include <vector>
+#include <typeinfo>
+#include <string_view>
+#include <unordered_map>
+#include <memory_resource>
+#include <nlohmann/json.hpp>
+#include "scenario.hpp"
+#include "adjacency.hpp"
+#include "serialization.hpp"
+
+namespace sim_engine {
+    /**
+     * Flat representation of an agent scenario (i.e., the same scenario that cells_coupled::add_cells_json builds).
+     * Cells are identified by their position in the JSON file (cell IDs are sorted alphabetically).
+     * @tparam K kernel of the cells in the graph.
+     */
+    template <typename K>
+    struct graph {
+        using S = typename K::state_type;
+        using V = typename K::vicinity_type;
+        using C = typename K::config_type;
+
+        std::vector<std::string> ids;                               /// ID of every cell
+        std::vector<S> states;                                      /// initial state of every cell
+        std::vector<C> configs;                                     /// configuration of every cell
+        adjacency<V> neighbors;                                     /// neighbor cells and vicinities of every cell (CSR)
+        std::vector<edge_weight_type<K>> weights;                   /// weight of every edge, in the same order as neighbors (empty unless folded)
+
+        [[nodiscard]] std::size_t size() const {
+            return states.size();
+        }
+
+        /**
+         * @param i index of a cell.
+         * @return neighbors of the cell as a row of (neighbor index, edge weight) pairs.
+         */
+        [[nodiscard]] typename adjacency<edge_weight_type<K>>::row weighted_neighbors(std::size_t i) const {
+            return neighbors.with(i, weights);
+        }
+
+        /**
+         * Calls a function with the neighbors of a cell: as a row of (neighbor index, edge weight) pairs if the edge
+         * weights were folded, or as a row of (neighbor index, vicinity) pairs otherwise. Kernels that define edge
+         * weights define neighbor_contribution for both, so the function is usually a generic lambda.
+         * @param i index of a cell.
+         * @param f function that takes a row of neighbors.
+         * @return the result of f.
+         */
+        template <typename F>
+        auto visit_neighbors(std::size_t i, F &&f) const {
+            return weights.empty()? f(neighbors[i]) : f(weighted_neighbors(i));
+        }
+
+        /**
+         * Computes the weight of every edge once (see --frozen-vicinity). Runners then read the weights instead of the
+         * vicinities. It must be called again whenever the neighbors change.
+         */
+        void fold_weights() {
+            weights.clear();
+            weights.reserve(neighbors.edges());
+            for (auto const &v: neighbors.neighbor_vicinities()) {
+                weights.push_back(kernel_edge_weight<K>(v));
+            }
+        }
+
+        /**
+         * @param index index of a cell
+         * @return cell ID as printed in the simulation logs
+         */
+        [[nodiscard]] std::string const &cell_id(std::size_t index) const {
+            return ids[index];
+        }
+
+        /**
+         * Reads an agent scenario from a JSON file.
+         * @param file_path path to the JSON scenario configuration file
+         * @return flat graph with the initial state, configuration, and neighborhood of every cell
+         * @throw std::bad_typeid if a cell type does not correspond to the kernel
+         */
+        static graph from_json(std::string const &file_path) {
+            return from_json(read_json(file_path));
+        }
+
+        static graph from_json(nlohmann::json const &j) {
+            graph res;
+            auto const &cells = j.at("cells");
+            res.ids.reserve(cells.size());  // the index refers to the IDs, so they must not be moved
+            // The index is only needed while the graph is built: all its nodes are released at once
+            std::pmr::monotonic_buffer_resource arena;
+            std::pmr::unordered_map<std::string_view, std::size_t> indices(&arena);
+            indices.reserve(cells.size());
+            std::size_t n_edges = 0;
+            auto default_neighbors = cells.at("default").value("neighborhood", nlohmann::json::object()).size();
+            for (auto const &item: cells.items()) {
+                if (item.key() != "default") {
+                    res.ids.push_back(item.key());
+                    indices.emplace(res.ids.back(), res.ids.size() - 1);
+                    auto neighborhood = item.value().find("neighborhood");
+                    n_edges += (neighborhood == item.value().end())? default_neighbors : neighborhood->size();
+                }
+            }
+            res.states.resize(res.ids.size());
+            res.configs.resize(res.ids.size());
+            res.neighbors.reserve(res.ids.size(), n_edges);
+            nlohmann::json merged;
+            for (std::size_t i = 0; i < res.ids.size(); ++i) {
+                if (cell_spec_field(j, res.ids[i], "cell_type", merged) != K::cell_type) {
+                    throw std::bad_typeid();
+                }
+                res.states[i] = cell_spec_field(j, res.ids[i], "state", merged).get<S>();
+                res.configs[i] = cell_spec_field(j, res.ids[i], "config", merged).get<C>();
+                res.neighbors.add_cell();
+                for (auto const &n: cell_spec_field(j, res.ids[i], "neighborhood", merged).items()) {
+                    res.neighbors.add_neighbor(indices.at(n.key()), n.value().get<V>());
+                }
+            }
+            return res;
+        }
+
+        /**
+         * Reads the configuration of every cell of an agent scenario, without building its topology.
+         * @param j JSON scenario configuration
+         * @return configuration of every cell, in the same order as the cells of from_json
+         * @throw std::bad_typeid if a cell type does not correspond to the kernel
+         */
+        static std::vector<C> configurations(nlohmann::json const &j) {
+            std::vector<C> res;
+            for (auto const &item: j.at("cells").items()) {
+                if (item.key() != "default") {
+                    nlohmann::json merged;
+                    if (cell_spec_field(j, item.key(), "cell_type", merged) != K::cell_type) {
+                        throw std::bad_typeid();
+                    }
+                    res.push_back(cell_spec_field(j, item.key(), "config", merged).get<C>());
+                }
+            }
+            return res;
+        }
+
+        /**
+         * Writes the graph in binary format (e.g., for checkpoints).
+         * @param os output stream.
+         */
+        void save(std::ostream &os) const {
+            write_binary(os, ids);
+            write_binary(os, states);
+            write_binary(os, configs);
+            write_binary(os, neighbors);
+            write_binary(os, !weights.empty());  // weights are derived from the vicinities, so only whether they were folded is saved
+        }
+
+        /**
+         * Reads a graph written with save. It is much faster than building it from the JSON scenario file.
+         * @param is input stream.
+         * @return the graph.
+         * @throw std::runtime_error if the stream ends before the whole graph is read.
+         */
+        static graph load(std::istream &is) {
+            graph res;
+            read_binary(is, res.ids);
+            read_binary(is, res.states);
+            read_binary(is, res.configs);
+            read_binary(is, res.neighbors);
+            bool folded;
+            read_binary(is, folded);
+            if (folded) {
+                res.fold_weights();
+            }
+            return res;
+        }
+
+        /**
+         * Splits the graph in blocks of consecutive cells (i.e., of cells whose IDs are alphabetically close).
+         * @param side square root of the number of cells per block (as in lattices).
+         * @return range of cell indices of every block.
+         */
+        [[nodiscard]] std::vector<std::vector<std::pair<std::size_t, std::size_t>>> blocks(std::size_t side) const {
+            std::vector<std::vector<std::pair<std::size_t, std::size_t>>> res;
+            auto chunk = side * side;
+            for (std::size_t first = 0; first < size(); first += chunk) {
+                res.push_back({{first, std::min(first + chunk, size())}});
+            }
+            return res;
+        }
+
+        /**
+         * Checks that every cell in a scenario can be simulated with a given kernel.
+         * @param j JSON scenario configuration
+         * @return true if all the cells of the scenario are of the kernel's cell type
+         */
+        static bool compatible(nlohmann::json const &j) {
+            if (j.contains("shape")) {
+                return false;
+            }
+            for (auto const &item: j.at("cells").items()) {
+                if (cell_spec_json(j, item.key()).value("cell_type", "") != K::cell_type) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_GRAPH_HPP
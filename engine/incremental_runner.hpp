@@ -0,0 +1,466 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_INCREMENTAL_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_INCREMENTAL_RUNNER_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include "graph.hpp"
+#include "lattice.hpp"
+#include "checkpoint.hpp"
+#include "serialization.hpp"
+
+namespace sim_engine {
+    /**
+     * Runner that records the state changes and the state log of every tick (its trace), so that a later run of the
+     * same scenario with a few edited cells (e.g., a different configuration or neighborhood of one region) only
+     * recomputes the causal cone of the edition. As in the dense runner, cells advance in lockstep with a constant
+     * output delay.
+     *
+     * While there is a recorded trace, a tick only evaluates the edited cells, the cells whose state (or whether they
+     * publish it) diverged from the recorded run in the previous tick, and the followers of the diverged cells. Every
+     * other cell has exactly the same inputs as in the recorded run, so it takes its recorded state change without
+     * evaluating its neighborhood, and its recorded log line is copied as is. The cone only grows while the new states
+     * actually differ from the recorded ones. Ticks beyond the recorded trace are simulated as in the active schedule
+     * of the dense runner. The state log is the same as the one of the dense runner, and the trace of the new run is
+     * the recorded trace of the next one.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells. It must have a constant output delay.
+     * @tparam M flat scenario representation (lattice or graph).
+     */
+    template <typename T, typename K, typename M = lattice<K>>
+    class incremental_runner {
+        using S = typename K::state_type;
+        using V = typename K::vicinity_type;
+        using A = decltype(K::neighbor_contribution(std::declval<S>(), std::declval<V>()));
+
+        /// State changes and state log lines of every tick of a run
+        struct trace {
+            std::vector<std::vector<std::pair<std::size_t, S>>> changes;    /// cells that changed in every tick
+            std::string text;                   /// state log lines of all the ticks (without the time lines)
+            std::vector<std::uint64_t> cells = {};      /// cell of every log line
+            std::vector<std::uint64_t> lines = {0};     /// offset of every log line in the text (and the text size)
+            std::vector<std::uint64_t> ticks = {0};     /// first log line of every tick (and the number of lines)
+
+            void save(std::ostream &os) const {
+                std::vector<std::uint64_t> offsets = {0}, indices;
+                std::vector<S> states;
+                for (auto const &tick_changes: changes) {
+                    for (auto const &[i, s]: tick_changes) {
+                        indices.push_back(i);
+                        states.push_back(s);
+                    }
+                    offsets.push_back(indices.size());
+                }
+                write_binary(os, offsets);
+                write_binary(os, indices);
+                write_binary(os, states);
+                write_binary(os, text);
+                write_binary(os, cells);
+                write_binary(os, lines);
+                write_binary(os, ticks);
+            }
+
+            static trace load(std::istream &is) {
+                trace res;
+                std::vector<std::uint64_t> offsets, indices;
+                std::vector<S> states;
+                read_binary(is, offsets);
+                read_binary(is, indices);
+                read_binary(is, states);
+                res.changes.resize(offsets.empty()? 0 : offsets.size() - 1);
+                for (std::size_t k = 0; k < res.changes.size(); ++k) {
+                    for (auto j = offsets[k]; j < offsets[k + 1]; ++j) {
+                        res.changes[k].emplace_back(indices[j], states[j]);
+                    }
+                }
+                read_binary(is, res.text);
+                read_binary(is, res.cells);
+                read_binary(is, res.lines);
+                read_binary(is, res.ticks);
+                return res;
+            }
+        };
+
+        M model;                                /// scenario being simulated
+        std::vector<std::vector<std::size_t>> followers;    /// cells that have each cell in their neighborhood
+        std::vector<S> current;                 /// current (and latest published) state of every cell
+        std::vector<char> published;            /// cells that publish their state in the current tick
+        std::vector<std::size_t> publishers;    /// indices of the cells that publish their state in the current tick
+        trace recorded;                         /// trace of the recorded run (empty if there is none)
+        trace record;                           /// trace of this run
+        std::vector<S> recorded_states;         /// state of every cell in the recorded run
+        std::vector<char> recorded_published;   /// cells that publish their state in the current tick of the recorded run
+        std::vector<std::size_t> edited;        /// cells whose state, configuration, or neighborhood were edited
+        std::vector<std::size_t> diverged;      /// cells that differ from the recorded run after the previous tick
+        std::vector<char> marks;                /// cells already added to the sequence being built
+        std::ostream &state_log;                /// output stream for the state log
+        T clock = 0;                            /// current simulation time
+        std::size_t tick = 0;                   /// number of ticks simulated so far
+
+        template <typename X>
+        static bool same_bytes(X const &a, X const &b) {
+            static_assert(std::is_trivially_copyable<X>::value, "only trivially copyable values can be compared as raw bytes");
+            return std::memcmp(&a, &b, sizeof(X)) == 0;
+        }
+
+        /**
+         * Compares the scenario with the one of a recorded run.
+         * @param old scenario of the recorded run.
+         * @param res indices of the cells whose initial state, configuration, or neighborhood differ.
+         * @return false if the scenarios do not have the same cells, or only one of them has folded weights.
+         */
+        bool compare(M const &old, std::vector<std::size_t> &res) const {
+            if (old.size() != model.size() || old.weights.empty() != model.weights.empty()) {
+                return false;
+            }
+            for (std::size_t i = 0; i < model.size(); ++i) {
+                if (old.cell_id(i) != model.cell_id(i)) {
+                    return false;
+                }
+                bool same = !(old.states[i] != model.states[i]) && same_bytes(old.configs[i], model.configs[i]) &&
+                        old.neighbors[i].size() == model.neighbors[i].size();
+                for (std::size_t k = 0; same && k < model.neighbors[i].size(); ++k) {
+                    same = old.neighbors[i][k].first == model.neighbors[i][k].first &&
+                            same_bytes(old.neighbors[i][k].second, model.neighbors[i][k].second);
+                }
+                if (!same) {
+                    res.push_back(i);
+                }
+            }
+            return true;
+        }
+
+        /// @return a sorted sequence with the given cells and their followers
+        std::vector<std::size_t> with_followers(std::vector<std::size_t> const &cells) {
+            std::vector<std::size_t> res;
+            auto add = [&](std::size_t i) {
+                if (!marks[i]) {
+                    marks[i] = true;
+                    res.push_back(i);
+                }
+            };
+            for (auto i: cells) {
+                add(i);
+                for (auto f: followers[i]) {
+                    add(f);
+                }
+            }
+            for (auto i: res) {
+                marks[i] = false;
+            }
+            std::sort(res.begin(), res.end());
+            return res;
+        }
+
+        /// @return true if a cell publishes or receives a new state in the current tick (i.e., if it is logged)
+        [[nodiscard]] bool involved(std::size_t i) const {
+            if (published[i]) {
+                return true;
+            }
+            for (auto const &neighbor: model.neighbors[i]) {
+                if (published[neighbor.first]) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// @return new state of a cell in the current tick (the current one if no neighbor publishes its state)
+        S evaluate(std::size_t i) const {
+            bool imminent = false;
+            for (auto const &neighbor: model.neighbors[i]) {
+                imminent |= (bool) published[neighbor.first];
+            }
+            if (!imminent) {
+                return current[i];
+            }
+            A aux = model.visit_neighbors(i, [&](auto const &row) {
+                A res = 0;
+                for (auto const &[neighbor, weight]: row) {
+                    res += K::neighbor_contribution(current[neighbor], weight);
+                }
+                return res;
+            });
+            return K::local_computation(current[i], aux, model.configs[i]);
+        }
+
+        /// Advances the recorded run one tick.
+        void advance_recorded() {
+            if (tick == 0) {
+                std::fill(recorded_published.begin(), recorded_published.end(), false);
+            } else {
+                for (auto const &change: recorded.changes[tick - 1]) {
+                    recorded_published[change.first] = false;
+                }
+            }
+            for (auto const &[i, s]: recorded.changes[tick]) {
+                recorded_states[i] = s;
+                recorded_published[i] = true;
+            }
+        }
+
+        /**
+         * Writes the log lines of the current tick. Lines of the cells that were not evaluated are copied from the
+         * recorded trace, and lines of the evaluated cells are written again.
+         * @param os output stream for the log lines of the current tick.
+         * @param cells sorted sequence of the cells evaluated in the current tick.
+         * @param logged sorted sequence of the cells to be logged (only the evaluated ones if replay is true).
+         * @param replay true if the current tick is in the recorded trace.
+         */
+        void write_lines(std::ostringstream &os, std::vector<std::size_t> const &cells,
+                         std::vector<std::size_t> const &logged, bool replay) {
+            auto base = record.text.size();
+            auto write_line = [&](std::size_t i) {
+                os << "State for model " << model.cell_id(i) << " is " << current[i] << "\n";
+                record.cells.push_back(i);
+                record.lines.push_back(base + (std::uint64_t) os.tellp());
+            };
+            auto l = logged.begin();
+            if (replay) {
+                auto c = cells.begin();
+                auto j = recorded.ticks[tick], last = recorded.ticks[tick + 1];
+                while (j < last) {
+                    // Lines of evaluated cells go before the recorded line of the same cell, which is discarded
+                    for (; l != logged.end() && *l <= recorded.cells[j]; ++l) {
+                        write_line(*l);
+                    }
+                    while (c != cells.end() && *c < recorded.cells[j]) {
+                        ++c;
+                    }
+                    if (c != cells.end() && *c == recorded.cells[j]) {
+                        ++j;
+                        continue;
+                    }
+                    // Recorded lines up to the next evaluated cell are copied in a single block
+                    auto from = j;
+                    auto offset = base + (std::uint64_t) os.tellp() - recorded.lines[from];
+                    for (; j < last && (c == cells.end() || recorded.cells[j] < *c); ++j) {
+                        record.cells.push_back(recorded.cells[j]);
+                        record.lines.push_back(offset + recorded.lines[j + 1]);
+                    }
+                    os.write(recorded.text.data() + recorded.lines[from],
+                             (std::streamsize) (recorded.lines[j] - recorded.lines[from]));
+                }
+            }
+            for (; l != logged.end(); ++l) {
+                write_line(*l);
+            }
+        }
+
+        /// Advances the scenario one tick.
+        void step() {
+            bool replay = tick + 1 < recorded.ticks.size();
+            // Cells that may not take the state change of the recorded run, and cells to be logged
+            std::vector<std::size_t> cells, logged;
+            if (replay) {
+                cells = with_followers(diverged);
+                cells.insert(cells.end(), edited.begin(), edited.end());
+                std::sort(cells.begin(), cells.end());
+                cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+                for (auto i: cells) {
+                    if (involved(i)) {
+                        logged.push_back(i);
+                    }
+                }
+            } else {
+                cells = with_followers(publishers);
+                logged = cells;
+            }
+            std::vector<std::pair<std::size_t, S>> tick_changes;
+            for (auto i: cells) {
+                auto s = evaluate(i);
+                if (s != current[i]) {
+                    tick_changes.emplace_back(i, s);
+                }
+            }
+            if (replay) {
+                for (auto i: cells) {
+                    marks[i] = true;
+                }
+                for (auto const &change: recorded.changes[tick]) {
+                    if (!marks[change.first]) {
+                        tick_changes.push_back(change);  // the cell has the same inputs as in the recorded run
+                    }
+                }
+                for (auto i: cells) {
+                    marks[i] = false;
+                }
+                std::sort(tick_changes.begin(), tick_changes.end(), [](auto const &a, auto const &b) {
+                    return a.first < b.first;
+                });
+            }
+            for (auto p: publishers) {
+                published[p] = false;
+            }
+            publishers.clear();
+            for (auto const &[i, s]: tick_changes) {
+                current[i] = s;
+                published[i] = true;
+                publishers.push_back(i);
+            }
+            std::ostringstream os;
+            write_lines(os, cells, logged, replay);
+            auto lines = os.str();
+            if (!lines.empty()) {  // as in Cadmium, ticks without any cell involved do not appear in the state log
+                state_log << clock << std::endl;
+                state_log << lines;
+            }
+            record.text += lines;
+            record.ticks.push_back(record.cells.size());
+            record.changes.push_back(std::move(tick_changes));
+            if (replay) {
+                advance_recorded();
+                diverged.clear();
+                for (auto i: cells) {
+                    if (current[i] != recorded_states[i] || published[i] != recorded_published[i]) {
+                        diverged.push_back(i);
+                    }
+                }
+            }
+            clock += K::output_delay;
+            ++tick;
+        }
+    public:
+        /**
+         * Creates a new incremental runner without a recorded trace. At the beginning of the simulation, every cell
+         * publishes its initial state.
+         * @param model lattice or graph to be simulated.
+         * @param state_log output stream for the state log.
+         */
+        incremental_runner(M model, std::ostream &state_log) : model(std::move(model)), state_log(state_log) {
+            auto n = this->model.size();
+            current = this->model.states;
+            published = std::vector<char>(n, true);
+            publishers.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                publishers[i] = i;
+            }
+            followers.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (auto const &neighbor: this->model.neighbors[i]) {
+                    followers[neighbor.first].push_back(i);
+                }
+            }
+            marks = std::vector<char>(n, false);
+        }
+
+        /**
+         * Creates a new incremental runner that reuses the trace of a previous run.
+         * If the previous run simulated a scenario with different cells, its trace is ignored.
+         * @param model lattice or graph to be simulated.
+         * @param is input stream with the trace written by save.
+         * @param state_log output stream for the state log.
+         * @throw std::runtime_error if the stream does not contain a valid trace.
+         */
+        incremental_runner(M model, std::istream &is, std::ostream &state_log) :
+                incremental_runner(std::move(model), state_log) {
+            check_header(is, "incremental_runner trace");
+            auto old = M::load(is);
+            auto old_trace = trace::load(is);
+            if (!compare(old, edited)) {
+                edited.clear();
+                return;
+            }
+            recorded = std::move(old_trace);
+            recorded_states = old.states;
+            recorded_published = std::vector<char>(recorded_states.size(), true);
+            diverged = edited;
+        }
+
+        /**
+         * Writes the scenario and the trace of the simulated ticks. They are the recorded run of the next one.
+         * @param os output stream for the trace.
+         */
+        void save(std::ostream &os) const {
+            write_header(os, "incremental_runner trace");
+            model.save(os);
+            record.save(os);
+        }
+
+        /**
+         * Runs the simulation until the given time.
+         * @param t simulation time at which the simulation stops.
+         * @return the time of the next tick.
+         */
+        T run_until(T t) {
+            while (clock < t) {
+                step();
+            }
+            return clock;
+        }
+
+        /// @return cells whose initial state, configuration, or neighborhood differ from the ones of the recorded run
+        [[nodiscard]] std::vector<std::size_t> const &edited_cells() const {
+            return edited;
+        }
+
+        /// @return time of the next tick
+        [[nodiscard]] T time() const {
+            return clock;
+        }
+
+        /// @return current state of every cell
+        [[nodiscard]] std::vector<S> const &states() const {
+            return current;
+        }
+    };
+
+    /**
+     * Simulates a scenario reusing the trace of a previous run (if the trace file exists), and replaces the trace file
+     * with the one of the new run.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells.
+     * @tparam M flat scenario representation (lattice or graph).
+     * @param model lattice or graph to be simulated.
+     * @param trace_path path of the trace file.
+     * @param state_log output stream for the state log.
+     * @param t simulation time at which the simulation stops.
+     * @throw std::runtime_error if the trace file is not valid or the new trace cannot be written.
+     */
+    template <typename T, typename K, typename M>
+    void run_incremental(M model, std::string const &trace_path, std::ostream &state_log, T t) {
+        std::ifstream is(trace_path, std::ios::binary);
+        auto runner = is? incremental_runner<T, K, M>(std::move(model), is, state_log) :
+                incremental_runner<T, K, M>(std::move(model), state_log);
+        is.close();
+        runner.run_until(t);
+        write_checkpoint(runner, trace_path);
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_INCREMENTAL_RUNNER_HPP
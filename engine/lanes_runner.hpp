@@ -0,0 +1,219 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_LANES_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_LANES_RUNNER_HPP
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include "graph.hpp"
+#include "lattice.hpp"
+#include "termination.hpp"
+
+namespace sim_engine {
+    /**
+     * Lockstep runner for N scenarios that share the same topology (e.g., the runs of a parameter sweep).
+     * The state of every cell packs one lane per scenario, and the runner evaluates all the lanes of a cell in a single
+     * pass. It behaves as N dense runners: every lane keeps track of its own published cells, so a lane only takes the
+     * new state of a cell if the cell received a new neighbor state in that lane. Every lane writes its own state log,
+     * and it may have its own termination predicate.
+     *
+     * Lane kernels pack N states and configurations of a scalar kernel. They must define:
+     *   - state_type, config_type, vicinity_type and aggregate_type: the packed structs and the neighbor aggregate.
+     *   - lanes and output_delay constants.
+     *   - lane(x, k) and set_lane(x, k, value) for accessing lane k of packed states and configurations.
+     *   - add_contribution(aggregate, neighbor, vicinity) and local_computation(state, aggregate, config). If the
+     *     scalar kernel defines edge weights (see has_edge_weight), also add_contribution(aggregate, neighbor, weight).
+     * @tparam T data type used to represent the simulation time.
+     * @tparam L lane kernel.
+     * @tparam M flat scenario representation of the scalar kernel (lattice or graph).
+     */
+    template <typename T, typename L, typename M>
+    class lanes_runner {
+        static constexpr std::size_t N = L::lanes;
+        static_assert(N <= 32, "lane masks hold up to 32 lanes");
+        using S = typename L::state_type;
+        using C = typename L::config_type;
+        using mask = std::uint32_t;
+
+        std::shared_ptr<M const> model;         /// scenario topology shared by all the lanes
+        std::vector<C> configs;                 /// packed configuration of every cell
+        std::vector<S> current;                 /// packed current (and latest published) state of every cell
+        std::vector<S> next;                    /// back buffer for the states computed in the current tick
+        std::vector<mask> published;            /// lanes in which every cell publishes its state in the current tick
+        std::vector<mask> changed;              /// lanes in which every cell changed its state in the current tick
+        std::array<std::ostream *, N> logs;     /// output stream for the state log of every lane
+        std::array<termination<typename M::S> *, N> stops{};  /// termination predicate of every lane (if any)
+        std::array<std::size_t, N> n_changed{}; /// number of cells that changed their state in every lane this tick
+        mask running = (mask) ((1ull << N) - 1);  /// lanes whose termination predicate is not fulfilled yet
+        T clock;                                /// current simulation time
+    public:
+        /**
+         * Creates a new lanes runner. At the beginning of the simulation, every cell publishes its initial state.
+         * @param model lattice or graph to be simulated.
+         * @param lane_configs configuration of every cell in every lane.
+         * @param lane_logs output stream for the state log of every lane.
+         * @param init_time initial simulation time.
+         */
+        lanes_runner(std::shared_ptr<M const> model, std::array<std::vector<typename M::C>, N> const &lane_configs,
+                     std::array<std::ostream *, N> lane_logs, T init_time = 0) :
+                model(std::move(model)), logs(lane_logs), clock(init_time) {
+            auto n = this->model->states.size();
+            current.resize(n);
+            configs.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (std::size_t k = 0; k < N; ++k) {
+                    L::set_lane(current[i], k, this->model->states[i]);
+                    L::set_lane(configs[i], k, lane_configs[k].at(i));
+                }
+            }
+            next = current;
+            published = std::vector<mask>(n, running);
+            changed = std::vector<mask>(n, 0);
+        }
+
+        /**
+         * Runs the simulation until the given time.
+         * @param t simulation time at which the simulation stops.
+         * @return the time of the next tick.
+         */
+        T run_until(T t) {
+            while (clock < t) {
+                step();
+            }
+            return clock;
+        }
+
+        /**
+         * Runs the simulation until the given time or until the termination predicates of all the lanes are fulfilled.
+         * A lane stops as soon as its own predicate is fulfilled (its cells keep their state and its state log ends),
+         * as a dense runner with the same predicate would. Predicates only see the cells that changed their state.
+         * @param t simulation time at which the simulation stops.
+         * @param predicates termination predicate of every lane.
+         * @return the time of the next tick.
+         */
+        T run_until(T t, std::array<termination<typename M::S> *, N> const &predicates) {
+            stops = predicates;
+            std::vector<typename M::S> lane_states(current.size());
+            for (std::size_t k = 0; k < N; ++k) {
+                if (stops[k]->never()) {
+                    stops[k] = nullptr;
+                    continue;
+                }
+                for (std::size_t i = 0; i < current.size(); ++i) {
+                    lane_states[i] = L::lane(current[i], k);
+                }
+                stops[k]->start(lane_states);
+            }
+            while (clock < t && running) {
+                step();
+                for (std::size_t k = 0; k < N; ++k) {
+                    if (stops[k] != nullptr && (running >> k & 1u) && stops[k]->done(n_changed[k])) {
+                        running &= ~((mask) 1 << k);
+                    }
+                }
+            }
+            stops = {};
+            return clock;
+        }
+
+        /// Advances all the running lanes one tick.
+        void step() {
+            // As in Cadmium, lanes without any cell that publishes its state do not log the tick
+            mask involved = 0;
+            for (auto p: published) {
+                involved |= p;
+            }
+            involved &= running;
+            for (std::size_t k = 0; k < N; ++k) {
+                if (involved >> k & 1u) {
+                    *logs[k] << clock << std::endl;
+                }
+            }
+            n_changed = {};
+            if (!involved) {
+                clock += L::output_delay;
+                return;
+            }
+            for (std::size_t i = 0; i < current.size(); ++i) {
+                mask imminent = 0;
+                for (auto const &neighbor: model->neighbors[i]) {
+                    imminent |= published[neighbor.first];
+                }
+                imminent &= running;
+                next[i] = current[i];
+                changed[i] = 0;
+                if (imminent) {
+                    auto aux = model->visit_neighbors(i, [&](auto const &row) {
+                        typename L::aggregate_type res{};
+                        for (auto const &[neighbor, weight]: row) {
+                            L::add_contribution(res, current[neighbor], weight);
+                        }
+                        return res;
+                    });
+                    auto candidate = L::local_computation(current[i], aux, configs[i]);
+                    for (std::size_t k = 0; k < N; ++k) {
+                        if (imminent >> k & 1u) {
+                            auto lane = L::lane(candidate, k);
+                            if (lane != L::lane(current[i], k)) {
+                                if (stops[k] != nullptr) {
+                                    stops[k]->update(L::lane(current[i], k), lane);
+                                }
+                                L::set_lane(next[i], k, lane);
+                                changed[i] |= (mask) 1 << k;
+                                n_changed[k]++;
+                            }
+                        }
+                    }
+                }
+                mask logged = (imminent | published[i]) & running;
+                if (logged) {
+                    auto id = model->cell_id(i);
+                    for (std::size_t k = 0; k < N; ++k) {
+                        if (logged >> k & 1u) {
+                            *logs[k] << "State for model " << id << " is " << L::lane(next[i], k) << "\n";
+                        }
+                    }
+                }
+            }
+            std::swap(current, next);
+            std::swap(published, changed);
+            clock += L::output_delay;
+        }
+
+        /// @return packed current state of every cell
+        [[nodiscard]] std::vector<S> const &states() const {
+            return current;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_LANES_RUNNER_HPP
@@ -0,0 +1,492 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_LATTICE_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_LATTICE_HPP
+
+#include <map>
+#include <array>
+#include <cstddef>
+#include <set>
+#include <string>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <typeinfo>
+#include <unordered_map>
+#include <memory_resource>
+#include <nlohmann/json.hpp>
+#include "scenario.hpp"
+#include "adjacency.hpp"
+#include "serialization.hpp"
+
+namespace sim_engine {
+    /**
+     * Flat representation of a grid scenario (i.e., the same scenario that grid_coupled::add_lattice_json builds).
+     * Cells are identified by their linearised position (row-major order, the last dimension is the fastest one).
+     * A lattice may also represent a rectangular tile of a bigger scenario. Then, the first cells are the ones owned
+     * by the tile (in row-major order within the tile), followed by ghost copies of the cells of other tiles that the
+     * owned cells have in their neighborhood. Ghost cells have no neighbors.
+     * The neighbors of every cell are sorted by their position in the whole lattice (as the cell models of the
+     * tutorials do), so the contributions of the neighbors of a cell are always added up in the same order, no matter
+     * the runner, the number of threads, or how the lattice is split in tiles.
+     * @tparam K kernel of the cells in the lattice.
+     */
+    template <typename K>
+    struct lattice {
+        using S = typename K::state_type;
+        using V = typename K::vicinity_type;
+        using C = typename K::config_type;
+
+        std::vector<int> shape;                                     /// shape of the lattice
+        bool wrapped = false;                                       /// if true, the lattice is a torus
+        std::vector<S> states;                                      /// initial state of every cell
+        std::vector<C> configs;                                     /// configuration of every cell
+        adjacency<V> neighbors;                                     /// neighbor cells and vicinities of every cell (CSR)
+        std::vector<edge_weight_type<K>> weights;                   /// weight of every edge, in the same order as neighbors (empty unless folded)
+        std::size_t n_owned = 0;                                    /// number of cells owned by the lattice
+        std::vector<std::size_t> globals;                           /// linearised position of every cell (empty if it is not a tile)
+
+        [[nodiscard]] std::size_t size() const {
+            return states.size();
+        }
+
+        /**
+         * @param i index of a cell in the lattice
+         * @return linearised position of the cell in the complete scenario
+         */
+        [[nodiscard]] std::size_t global(std::size_t i) const {
+            return globals.empty()? i : globals[i];
+        }
+
+        /**
+         * @param i index of a cell.
+         * @return neighbors of the cell as a row of (neighbor index, edge weight) pairs.
+         */
+        [[nodiscard]] typename adjacency<edge_weight_type<K>>::row weighted_neighbors(std::size_t i) const {
+            return neighbors.with(i, weights);
+        }
+
+        /**
+         * Calls a function with the neighbors of a cell: as a row of (neighbor index, edge weight) pairs if the edge
+         * weights were folded, or as a row of (neighbor index, vicinity) pairs otherwise. Kernels that define edge
+         * weights define neighbor_contribution for both, so the function is usually a generic lambda.
+         * @param i index of a cell.
+         * @param f function that takes a row of neighbors.
+         * @return the result of f.
+         */
+        template <typename F>
+        auto visit_neighbors(std::size_t i, F &&f) const {
+            return weights.empty()? f(neighbors[i]) : f(weighted_neighbors(i));
+        }
+
+        /**
+         * Computes the weight of every edge once (see --frozen-vicinity). Runners then read the weights instead of the
+         * vicinities. It must be called again whenever the neighbors change.
+         */
+        void fold_weights() {
+            weights.clear();
+            weights.reserve(neighbors.edges());
+            for (auto const &v: neighbors.neighbor_vicinities()) {
+                weights.push_back(kernel_edge_weight<K>(v));
+            }
+        }
+
+        /**
+         * @param index linearised position of a cell
+         * @return position of the cell in the lattice
+         */
+        [[nodiscard]] std::vector<int> position(std::size_t index) const {
+            std::vector<int> res(shape.size());
+            for (auto d = shape.size(); d-- > 0;) {
+                res[d] = (int) (index % shape[d]);
+                index /= shape[d];
+            }
+            return res;
+        }
+
+        /**
+         * @param pos position of a cell in the lattice
+         * @return linearised position of the cell
+         */
+        [[nodiscard]] std::size_t index(std::vector<int> const &pos) const {
+            std::size_t res = 0;
+            for (std::size_t d = 0; d < shape.size(); ++d) {
+                res = res * shape[d] + pos[d];
+            }
+            return res;
+        }
+
+        /**
+         * @param i index of a cell in the lattice
+         * @return cell ID as printed in the simulation logs (e.g., "(24,24)")
+         */
+        [[nodiscard]] std::string cell_id(std::size_t i) const {
+            std::stringstream ss;
+            auto pos = position(global(i));
+            ss << "(";
+            for (std::size_t d = 0; d < pos.size(); ++d) {
+                ss << ((d == 0)? "" : ",") << pos[d];
+            }
+            ss << ")";
+            return ss.str();
+        }
+
+        /**
+         * Reads a grid scenario from a JSON file.
+         * @param file_path path to the JSON scenario configuration file
+         * @return flat lattice with the initial state, configuration, and neighborhood of every cell
+         * @throw std::bad_typeid if a cell type does not correspond to the kernel or a neighborhood type is unknown
+         */
+        static lattice from_json(std::string const &file_path) {
+            return from_json(read_json(file_path));
+        }
+
+        static lattice from_json(nlohmann::json const &j) {
+            auto shape = j.at("shape").get<std::vector<int>>();
+            return tile(j, std::vector<int>(shape.size(), 0), shape);
+        }
+
+        /**
+         * Reads a rectangular tile of a grid scenario.
+         * @param j JSON scenario configuration
+         * @param from position of the first corner of the tile (included)
+         * @param to position of the opposite corner of the tile (excluded)
+         * @return flat lattice with the cells owned by the tile followed by the ghost cells they depend on
+         * @throw std::bad_typeid if a cell type does not correspond to the kernel or a neighborhood type is unknown
+         */
+        static lattice tile(nlohmann::json const &j, std::vector<int> const &from, std::vector<int> const &to) {
+            lattice res;
+            res.shape = j.at("shape").get<std::vector<int>>();
+            res.wrapped = j.value("wrapped", false);
+            auto cell_specs = specs(j);
+            std::unordered_map<std::size_t, std::string> spec_names;  // cells that do not use the default configuration
+            if (j.contains("cell_map")) {
+                for (auto const &item: j.at("cell_map").items()) {
+                    for (std::vector<int> pos: item.value()) {
+                        spec_names[res.index(pos)] = item.key();
+                    }
+                }
+            }
+            auto spec = [&](std::size_t global) -> cell_spec const & {
+                auto it = spec_names.find(global);
+                return cell_specs.at((it == spec_names.end())? "default" : it->second);
+            };
+            res.n_owned = 1;
+            for (std::size_t d = 0; d < res.shape.size(); ++d) {
+                res.n_owned *= to[d] - from[d];
+            }
+            res.states.resize(res.n_owned);
+            res.configs.resize(res.n_owned);
+            bool complete = res.n_owned == res.volume();
+            if (!complete) {
+                res.globals.resize(res.n_owned);  // the global positions of a complete lattice are not kept
+            }
+            std::unordered_map<std::size_t, std::size_t> ghosts;
+            auto local = [&](std::size_t global) {
+                if (complete) {
+                    return global;
+                }
+                auto pos = res.position(global);
+                std::size_t i = 0;
+                for (std::size_t d = 0; d < pos.size(); ++d) {
+                    if (pos[d] < from[d] || pos[d] >= to[d]) {
+                        auto [it, inserted] = ghosts.emplace(global, res.states.size());
+                        if (inserted) {
+                            res.states.push_back(spec(global).state);
+                            res.configs.push_back(spec(global).config);
+                            res.globals.push_back(global);
+                        }
+                        return it->second;
+                    }
+                    i = i * (to[d] - from[d]) + (pos[d] - from[d]);
+                }
+                return i;
+            };
+            res.neighbors.reserve(res.n_owned, res.n_owned * cell_specs.at("default").neighborhood.size());
+            // The neighbors of every cell are sorted in a scratch arena on the stack, which is reused by every cell
+            std::array<std::byte, 4096> scratch_buffer;
+            std::pmr::monotonic_buffer_resource scratch(scratch_buffer.data(), scratch_buffer.size());
+            std::vector<int> pos = from;
+            for (std::size_t i = 0; i < res.n_owned; ++i) {
+                scratch.release();
+                auto global = res.index(pos);
+                if (!complete) {
+                    res.globals[i] = global;
+                }
+                res.states[i] = spec(global).state;
+                res.configs[i] = spec(global).config;
+                // Neighbors are sorted by position, so contributions are always added up in the same order
+                std::pmr::vector<std::pair<std::size_t, V>> sorted(&scratch);
+                sorted.reserve(spec(global).neighborhood.size());
+                for (auto const &[relative, vicinity]: spec(global).neighborhood) {
+                    std::size_t neighbor;
+                    if (res.neighbor_index(pos, relative, neighbor)) {
+                        sorted.emplace_back(neighbor, vicinity);
+                    }
+                }
+                // Lattices are only built for compatible scenarios, whose cells never reach a neighbor twice: as the
+                // positions are unique, the sort needs not be stable (a stable sort allocates a temporary buffer)
+                std::sort(sorted.begin(), sorted.end(), [](auto const &a, auto const &b) {
+                    return a.first < b.first;
+                });
+                res.neighbors.add_cell();
+                for (auto const &[neighbor, vicinity]: sorted) {
+                    res.neighbors.add_neighbor(local(neighbor), vicinity);  // it may add a ghost cell
+                }
+                for (auto d = pos.size(); d-- > 0 && ++pos[d] == to[d];) {
+                    pos[d] = from[d];
+                }
+            }
+            res.neighbors.resize(res.states.size());  // ghost cells have no neighbors
+            return res;
+        }
+
+        /**
+         * Reads the configuration of every cell of a grid scenario, without building its topology.
+         * @param j JSON scenario configuration
+         * @return configuration of every cell, in the same order as the cells of from_json
+         * @throw std::bad_typeid if a cell type does not correspond to the kernel or a neighborhood type is unknown
+         */
+        static std::vector<C> configurations(nlohmann::json const &j) {
+            lattice res;
+            res.shape = j.at("shape").get<std::vector<int>>();
+            auto cell_specs = specs(j);
+            std::vector<C> configs(res.volume(), cell_specs.at("default").config);
+            if (j.contains("cell_map")) {
+                for (auto const &item: j.at("cell_map").items()) {
+                    for (std::vector<int> pos: item.value()) {
+                        configs[res.index(pos)] = cell_specs.at(item.key()).config;
+                    }
+                }
+            }
+            return configs;
+        }
+
+        /**
+         * Writes the lattice in binary format (e.g., for checkpoints).
+         * @param os output stream.
+         */
+        void save(std::ostream &os) const {
+            write_binary(os, shape);
+            write_binary(os, wrapped);
+            write_binary(os, states);
+            write_binary(os, configs);
+            write_binary(os, neighbors);
+            write_binary(os, (std::uint64_t) n_owned);
+            write_binary(os, globals);
+            write_binary(os, !weights.empty());  // weights are derived from the vicinities, so only whether they were folded is saved
+        }
+
+        /**
+         * Reads a lattice written with save. It is much faster than building it from the JSON scenario file.
+         * @param is input stream.
+         * @return the lattice.
+         * @throw std::runtime_error if the stream ends before the whole lattice is read.
+         */
+        static lattice load(std::istream &is) {
+            lattice res;
+            std::uint64_t n_owned;
+            read_binary(is, res.shape);
+            read_binary(is, res.wrapped);
+            read_binary(is, res.states);
+            read_binary(is, res.configs);
+            read_binary(is, res.neighbors);
+            read_binary(is, n_owned);
+            read_binary(is, res.globals);
+            res.n_owned = n_owned;
+            bool folded;
+            read_binary(is, folded);
+            if (folded) {
+                res.fold_weights();
+            }
+            return res;
+        }
+
+        /**
+         * Splits the lattice in square blocks (cubes in 3D lattices) of neighboring cells.
+         * Tiles of a distributed lattice are split in chunks of consecutive cells instead.
+         * @param side number of cells per dimension of every block.
+         * @return ranges of consecutive cell indices (i.e., pieces of rows) that form every block.
+         */
+        [[nodiscard]] std::vector<std::vector<std::pair<std::size_t, std::size_t>>> blocks(std::size_t side) const {
+            std::vector<std::vector<std::pair<std::size_t, std::size_t>>> res;
+            if (!globals.empty() || shape.size() < 2) {
+                auto chunk = side * side;
+                for (std::size_t first = 0; first < size(); first += chunk) {
+                    res.push_back({{first, std::min(first + chunk, size())}});
+                }
+                return res;
+            }
+            std::size_t n_blocks = 1;
+            for (auto s: shape) {
+                n_blocks *= (s + side - 1) / side;
+            }
+            res.resize(n_blocks);
+            std::size_t row = shape.back();
+            for (std::size_t first = 0; first < size();) {
+                auto pos = position(first);
+                std::size_t block = 0;
+                for (std::size_t d = 0; d < shape.size(); ++d) {
+                    block = block * ((shape[d] + side - 1) / side) + pos[d] / side;
+                }
+                auto last = std::min(first + side, first - pos.back() + row);  // ranges do not exceed their row
+                res[block].emplace_back(first, last);
+                first = last;
+            }
+            return res;
+        }
+
+        /**
+         * Checks that every cell in a scenario can be simulated with a given kernel.
+         * @param j JSON scenario configuration
+         * @return true if all the cells of the scenario are of the kernel's cell type, and no neighborhood of a wrapped
+         * lattice reaches the same cell through two relative positions (e.g., a range of 2 in a dimension of size 4)
+         */
+        static bool compatible(nlohmann::json const &j) {
+            if (!j.contains("shape")) {
+                return false;
+            }
+            for (auto const &item: j.at("cells").items()) {
+                if (cell_spec_json(j, item.key()).value("cell_type", "") != K::cell_type) {
+                    return false;
+                }
+            }
+            if (j.value("wrapped", false)) {
+                auto shape = j.at("shape").get<std::vector<int>>();
+                for (auto const &[name, spec]: specs(j)) {
+                    std::set<std::vector<int>> wrapped;
+                    for (auto const &[relative, vicinity]: spec.neighborhood) {
+                        auto pos = relative;
+                        for (std::size_t d = 0; d < shape.size(); ++d) {
+                            pos[d] = ((pos[d] % shape[d]) + shape[d]) % shape[d];
+                        }
+                        if (!wrapped.insert(pos).second) {
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+
+    private:
+        /// Initial state, configuration and relative neighborhood shared by all the cells of the same kind
+        struct cell_spec {
+            S state;
+            C config;
+            std::map<std::vector<int>, V> neighborhood;
+        };
+
+        [[nodiscard]] std::size_t volume() const {
+            std::size_t res = 1;
+            for (auto s: shape) {
+                res *= s;
+            }
+            return res;
+        }
+
+        /**
+         * @param pos position of a cell.
+         * @param relative relative position of one of its neighbors.
+         * @param res linearised position of the neighbor.
+         * @return false if the neighbor is out of the lattice.
+         */
+        bool neighbor_index(std::vector<int> const &pos, std::vector<int> const &relative, std::size_t &res) const {
+            res = 0;
+            for (std::size_t d = 0; d < shape.size(); ++d) {
+                int p = pos[d] + relative[d];
+                if (p < 0 || p >= shape[d]) {
+                    if (!wrapped) {
+                        return false;
+                    }
+                    p = ((p % shape[d]) + shape[d]) % shape[d];
+                }
+                res = res * shape[d] + p;
+            }
+            return true;
+        }
+
+
+        static std::map<std::string, cell_spec> specs(nlohmann::json const &j) {
+            std::map<std::string, cell_spec> res;
+            auto dimension = j.at("shape").size();
+            for (auto const &item: j.at("cells").items()) {
+                auto const &name = item.key();
+                nlohmann::json spec_json = cell_spec_json(j, name);
+                if (spec_json.at("cell_type") != K::cell_type) {
+                    throw std::bad_typeid();
+                }
+                cell_spec spec;
+                spec.state = spec_json.at("state").get<S>();
+                spec.config = spec_json.at("config").get<C>();
+                for (auto const &n: spec_json.at("neighborhood")) {
+                    auto vicinity = n.at("vicinity").get<V>();
+                    for (auto const &relative: relative_neighborhood(n, dimension)) {
+                        spec.neighborhood[relative] = vicinity;  // later neighborhoods override previous ones
+                    }
+                }
+                res[name] = spec;
+            }
+            return res;
+        }
+
+        static std::vector<std::vector<int>> relative_neighborhood(nlohmann::json const &n, std::size_t dimension) {
+            auto type = n.at("type").get<std::string>();
+            if (type == "custom") {
+                return n.at("neighbors").get<std::vector<std::vector<int>>>();
+            }
+            if (type != "moore" && type != "von_neumann") {
+                throw std::bad_typeid();
+            }
+            int range = n.value("range", 1);
+            std::vector<std::vector<int>> res;
+            std::vector<int> relative(dimension, -range);
+            while (true) {
+                int distance = 0;
+                for (auto r: relative) {
+                    distance += std::abs(r);
+                }
+                if (type == "moore" || distance <= range) {
+                    res.push_back(relative);
+                }
+                std::size_t d = dimension;
+                while (d-- > 0 && relative[d] == range) {
+                    relative[d] = -range;
+                }
+                if (d >= dimension) {
+                    return res;
+                }
+                relative[d]++;
+            }
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_LATTICE_HPP
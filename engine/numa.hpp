@@ -0,0 +1,153 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_NUMA_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_NUMA_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace sim_engine {
+    /**
+     * Parses a list of CPU or node indices in the format of the Linux sysfs (e.g., "0-3,8-11").
+     * @param list comma-separated list of indices and ranges of indices.
+     * @return all the indices of the list.
+     */
+    std::vector<int> parse_index_list(std::string const &list) {
+        std::vector<int> res;
+        std::stringstream ss(list);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            if (item.find_first_of("0123456789") == std::string::npos) {
+                continue;
+            }
+            auto dash = item.find('-');
+            auto first = std::stoi(item.substr(0, dash));
+            auto last = (dash == std::string::npos)? first : std::stoi(item.substr(dash + 1));
+            for (auto k = first; k <= last; ++k) {
+                res.push_back(k);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Reads the NUMA topology of the machine from the Linux sysfs.
+     * @return CPUs of every NUMA node with CPUs (empty if the topology cannot be read).
+     */
+    std::vector<std::vector<int>> numa_nodes() {
+        std::vector<std::vector<int>> res;
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string list;
+        if (!std::getline(online, list)) {
+            return res;
+        }
+        for (auto node: parse_index_list(list)) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string line;
+            auto cpus = std::getline(file, line)? parse_index_list(line) : std::vector<int>();
+            if (!cpus.empty()) {
+                res.push_back(cpus);
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Chooses a CPU for every thread of a pool. Threads are spread evenly across the NUMA nodes, and threads with
+     * consecutive indices share a node (runners deal contiguous ranges of cells to consecutive threads).
+     * @param n_threads number of threads of the pool.
+     * @return CPU of every thread (empty if the machine has a single NUMA node, as pinning would not pay off).
+     */
+    std::vector<int> numa_spread(std::size_t n_threads) {
+        std::vector<int> cpus, res;
+        auto nodes = numa_nodes();
+        if (nodes.size() < 2) {
+            return res;
+        }
+        for (auto const &node: nodes) {
+            cpus.insert(cpus.end(), node.begin(), node.end());
+        }
+        for (std::size_t i = 0; i < n_threads; ++i) {
+            res.push_back(cpus[i * cpus.size() / n_threads]);
+        }
+        return res;
+    }
+
+    /// @return CPUs where the calling thread is allowed to run (empty if they cannot be read).
+    std::vector<int> thread_affinity() {
+        std::vector<int> res;
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &mask)) {
+                    res.push_back(cpu);
+                }
+            }
+        }
+        return res;
+    }
+
+    /**
+     * Restricts the calling thread to a set of CPUs.
+     * @param cpus CPUs where the calling thread is allowed to run.
+     * @return true if the affinity of the thread was changed.
+     */
+    bool set_thread_affinity(std::vector<int> const &cpus) {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (auto cpu: cpus) {
+            CPU_SET(cpu, &mask);
+        }
+        return !cpus.empty() && sched_setaffinity(0, sizeof(mask), &mask) == 0;
+    }
+
+    /**
+     * Releases the memory pages that lie completely within a buffer. Their content is lost (they read as zeros), and
+     * the next write to each page allocates it again on the NUMA node of the writing thread (the first-touch policy
+     * of Linux). Bytes of the buffer that share a page with other data are left untouched.
+     * @param data pointer to the first byte of the buffer.
+     * @param size size of the buffer in bytes.
+     */
+    void release_pages(void *data, std::size_t size) {
+        auto page = (std::uintptr_t) sysconf(_SC_PAGESIZE);
+        auto first = ((std::uintptr_t) data + page - 1) / page * page;
+        auto last = ((std::uintptr_t) data + size) / page * page;
+        if (first < last) {
+            madvise((void *) first, last - first, MADV_DONTNEED);
+        }
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_NUMA_HPP
@@ -0,0 +1,511 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_OPTIMISTIC_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_OPTIMISTIC_RUNNER_HPP
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+#include <ostream>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+#include "graph.hpp"
+#include "lattice.hpp"
+#include "event_list.hpp"
+#include "work_stealing.hpp"
+
+namespace sim_engine {
+    /**
+     * Optimistic (Time Warp) parallel runner for lattices and agent graphs.
+     * As in the conservative runner, cells are split in logical processes (LPs) with roughly the same number of edges,
+     * and every LP runs on its own thread. However, LPs do not wait for the promises of their peers: they process their
+     * events as soon as they can, and roll back when they receive a message with an earlier time than the latest time
+     * they processed (a straggler). Thus, LPs with long delays are not held back by the shortest delay of the scenario.
+     *
+     * Every processed time is a frame that saves the values it overwrites (cell states, latest published states, and
+     * scheduled outputs). Transitions are side-effect-free, so restoring these values is all it takes to undo a frame.
+     * Outputs at time t only depend on events before t, so a straggler at time t only undoes the transitions of t and
+     * the later frames. The outputs of undone frames are cancelled with anti-messages, which roll back their receivers
+     * in turn if they already processed them.
+     *
+     * From time to time (when an LP runs out of events or frames), LPs meet to compute the global virtual time (GVT):
+     * the earliest time of all the unprocessed events and of the messages in transit. No frame before the GVT can be
+     * rolled back, so these frames are committed: their state log is written, and their saved values and messages are
+     * discarded (fossil collection). Every LP holds up to a fixed number of uncommitted frames, so memory stays bounded
+     * on long runs. The state log is the same as the one of the Cadmium runner.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells in the scenario.
+     * @tparam M flat scenario representation (lattice or graph).
+     */
+    template <typename T, typename K, typename M = lattice<K>>
+    class optimistic_runner {
+        using S = typename K::state_type;
+        using A = decltype(K::neighbor_contribution(std::declval<S>(), std::declval<typename K::vicinity_type>()));
+
+        static constexpr T never = std::numeric_limits<T>::max();
+
+        /// New state published by a cell (or cancellation of a previous one)
+        struct message {
+            T time;             /// simulation time at which the state is published
+            std::size_t cell;   /// index of the cell that publishes its state
+            S state;            /// published state
+            bool anti;          /// if true, the message cancels the previous message with the same time and cell
+        };
+
+        /// Values of a cell overwritten by a frame
+        struct saved_cell {
+            std::size_t cell;   /// index of the cell
+            S current;          /// previous state of the cell
+            S published;        /// previous latest published state of the cell
+            T due;              /// previous scheduled output time of the cell (never if none)
+        };
+
+        /// Processed time of an LP
+        struct frame {
+            T time;                                 /// simulation time of the frame
+            std::vector<std::size_t> publishers;    /// cells that published their state at this time
+            std::vector<saved_cell> published;      /// values overwritten by the outputs
+            std::vector<saved_cell> computed;       /// values overwritten by the transitions
+            std::vector<std::pair<std::size_t, S>> remote;  /// overwritten latest states of remote neighbors
+            bool received = false;                  /// if false, the transitions of this time are still pending
+            std::string log;                        /// state log of the frame
+        };
+
+        /// Logical process: a contiguous range of cells with its own event list
+        struct process {
+            std::size_t first, last;    /// range of cells [first, last) owned by the LP
+            std::unique_ptr<ordered_event_list<T>> outputs;     /// scheduled outputs (indexed from first)
+            std::map<T, std::vector<message>> inputs;   /// uncommitted messages received by the LP, sorted by time
+            std::unordered_map<std::size_t, S> remote;  /// latest published state of the neighbors owned by other LPs
+            std::mutex inbox_mutex;             /// mutex for the inbox
+            std::vector<message> inbox;         /// messages sent by other LPs that have not been read yet
+            std::vector<frame> frames;          /// uncommitted frames, sorted by time
+            T next = 0;                         /// time of the next event (as of the latest GVT computation)
+            bool idle = false;                  /// if true, the LP cannot process any event until the next GVT
+            std::vector<std::pair<T, std::string>> log;     /// committed state log of the cells of the LP (until it is written)
+        };
+
+        M model;                                /// scenario topology and cell configurations
+        std::vector<S> current;                 /// current state of every cell
+        std::vector<S> published;               /// latest published state of every cell
+        std::vector<std::size_t> owner;         /// LP of every cell
+        std::vector<std::vector<std::size_t>> followers;    /// cells that have each cell in their neighborhood
+        std::vector<std::vector<std::size_t>> targets;      /// LPs other than the owner with followers of each cell
+        std::vector<std::unique_ptr<process>> processes;    /// logical processes
+        std::size_t max_frames;                 /// maximum number of uncommitted frames of every LP
+        std::ostream &state_log;                /// output stream for the state log
+        T clock;                                /// time until which the scenario has been simulated
+
+        std::mutex gvt_mutex;                   /// mutex for the GVT computation
+        std::condition_variable gvt_done;       /// notifies the LPs that the GVT has been computed
+        std::atomic<bool> gvt_requested{false}; /// if true, LPs must meet to compute the GVT
+        std::atomic<std::size_t> n_idle{0};     /// number of LPs that cannot process any event
+        std::atomic<std::size_t> n_frames{0};   /// number of frames processed since the latest GVT computation
+        std::size_t n_arrived = 0;              /// number of LPs waiting for the GVT computation
+        std::size_t round = 0;                  /// number of GVT computations so far
+        T gvt;                                  /// latest global virtual time
+
+        /// @return true if the LP already computed the transitions of time t
+        static bool processed(process const &p, T t) {
+            return !p.frames.empty() && (p.frames.back().time > t || (p.frames.back().time == t && p.frames.back().received));
+        }
+
+        /// @return time of the next event of the LP
+        static T next_time(process const &p) {
+            if (!p.frames.empty() && !p.frames.back().received) {
+                return p.frames.back().time;
+            }
+            auto next_input = p.frames.empty()? p.inputs.begin() : p.inputs.upper_bound(p.frames.back().time);
+            return std::min(p.outputs->front(), (next_input == p.inputs.end())? never : next_input->first);
+        }
+
+        /// Sends a message to the inboxes of the LPs with followers of its cell.
+        void send(message const &m) {
+            for (auto target: targets[m.cell]) {
+                auto &q = *processes[target];
+                std::lock_guard<std::mutex> lock(q.inbox_mutex);
+                q.inbox.push_back(m);
+            }
+        }
+
+        /**
+         * Removes one message with the given time and cell from the inputs of the LP.
+         * @throw std::logic_error if the LP did not receive such a message.
+         */
+        static void erase_input(process &p, T t, std::size_t cell) {
+            auto it = p.inputs.find(t);
+            if (it == p.inputs.end()) {
+                throw std::logic_error("anti-message without its message");
+            }
+            auto &v = it->second;
+            auto msg = std::find_if(v.begin(), v.end(), [cell](message const &m) { return m.cell == cell; });
+            if (msg == v.end()) {
+                throw std::logic_error("anti-message without its message");
+            }
+            v.erase(msg);
+            if (v.empty()) {
+                p.inputs.erase(it);
+            }
+        }
+
+        /// Restores the values overwritten by a frame phase (in reverse order).
+        void restore(process &p, std::vector<saved_cell> &saved) {
+            for (auto it = saved.rbegin(); it != saved.rend(); ++it) {
+                current[it->cell] = it->current;
+                published[it->cell] = it->published;
+                if (it->due == never) {
+                    p.outputs->erase(it->cell - p.first);
+                } else {
+                    p.outputs->push(it->due, it->cell - p.first);
+                }
+            }
+            saved.clear();
+        }
+
+        /// Undoes the transitions of time t (if the LP computed them) and every later frame of the LP.
+        void rollback(process &p, T t) {
+            while (!p.frames.empty() && p.frames.back().time > t) {
+                auto &f = p.frames.back();
+                for (auto it = f.remote.rbegin(); it != f.remote.rend(); ++it) {
+                    p.remote[it->first] = it->second;
+                }
+                restore(p, f.computed);
+                restore(p, f.published);
+                for (auto i: f.publishers) {
+                    erase_input(p, f.time, i);
+                    send({f.time, i, current[i], true});
+                }
+                p.frames.pop_back();
+            }
+            if (!p.frames.empty() && p.frames.back().time == t && p.frames.back().received) {
+                auto &f = p.frames.back();
+                for (auto it = f.remote.rbegin(); it != f.remote.rend(); ++it) {
+                    p.remote[it->first] = it->second;
+                }
+                f.remote.clear();
+                restore(p, f.computed);
+                f.log.clear();
+                f.received = false;
+            }
+        }
+
+        /// Moves the messages of the inbox of the LP to its inputs, and rolls back the LP if they are stragglers.
+        void read_inbox(process &p) {
+            std::vector<message> messages;
+            {
+                std::lock_guard<std::mutex> lock(p.inbox_mutex);
+                messages.swap(p.inbox);
+            }
+            for (auto &m: messages) {
+                if (processed(p, m.time)) {
+                    rollback(p, m.time);
+                }
+                if (m.anti) {
+                    erase_input(p, m.time, m.cell);
+                } else {
+                    p.inputs[m.time].push_back(std::move(m));
+                }
+            }
+        }
+
+        /// Publishes the state of the cells of the LP whose output is scheduled at time t.
+        void publish(process &p, frame &f) {
+            while (p.outputs->front() == f.time) {
+                auto i = p.first + p.outputs->pop();
+                f.published.push_back({i, current[i], published[i], f.time});
+                f.publishers.push_back(i);
+                published[i] = current[i];
+                message m{f.time, i, current[i], false};
+                p.inputs[f.time].push_back(m);
+                send(m);
+            }
+        }
+
+        /// Delivers the messages with the time of the frame to the cells of the LP, which compute their new state.
+        void receive(process &p, frame &f) {
+            std::vector<std::size_t> receivers;
+            auto it = p.inputs.find(f.time);
+            if (it != p.inputs.end()) {
+                for (auto const &m: it->second) {
+                    if (owner[m.cell] != owner[p.first]) {
+                        auto &r = p.remote.at(m.cell);
+                        f.remote.emplace_back(m.cell, r);
+                        r = m.state;
+                    }
+                    for (auto fol: followers[m.cell]) {
+                        if (fol >= p.first && fol < p.last) {
+                            receivers.push_back(fol);
+                        }
+                    }
+                }
+            }
+            std::sort(receivers.begin(), receivers.end());
+            receivers.erase(std::unique(receivers.begin(), receivers.end()), receivers.end());
+            for (auto i: receivers) {
+                A aux = model.visit_neighbors(i, [&](auto const &row) {
+                    A res = 0;
+                    for (auto const &[neighbor, weight]: row) {
+                        auto const &n = (neighbor >= p.first && neighbor < p.last)? published[neighbor] : p.remote.at(neighbor);
+                        res += K::neighbor_contribution(n, weight);
+                    }
+                    return res;
+                });
+                auto next = K::local_computation(current[i], aux, model.configs[i]);
+                if (next != current[i]) {
+                    f.computed.push_back({i, current[i], published[i], p.outputs->scheduled(i - p.first)});
+                    current[i] = next;
+                    // inertial delay: the pending output (if any) is replaced by the new one
+                    p.outputs->push(f.time + kernel_delay<T, K>(published[i], next, model.configs[i]), i - p.first);
+                }
+            }
+            // Cells involved in the transitions of the frame are logged
+            receivers.insert(receivers.end(), f.publishers.begin(), f.publishers.end());
+            std::sort(receivers.begin(), receivers.end());
+            receivers.erase(std::unique(receivers.begin(), receivers.end()), receivers.end());
+            std::ostringstream ss;
+            for (auto i: receivers) {
+                ss << "State for model " << model.cell_id(i) << " is " << current[i] << "\n";
+            }
+            f.log = ss.str();
+            f.received = true;
+        }
+
+        /// Processes the events of the LP at time t.
+        void process_time(process &p, T t) {
+            if (p.frames.empty() || p.frames.back().time != t) {
+                p.frames.emplace_back();
+                p.frames.back().time = t;
+                publish(p, p.frames.back());
+            }
+            receive(p, p.frames.back());
+            n_frames.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        /**
+         * Waits until all the LPs meet, computes the GVT, commits the frames before the GVT, and writes their state log.
+         * The last LP to arrive computes the GVT: all the others are waiting, so no message is in flight.
+         */
+        void synchronize(process &p) {
+            p.next = next_time(p);
+            {
+                std::unique_lock<std::mutex> lock(gvt_mutex);
+                auto my_round = round;
+                if (++n_arrived < processes.size()) {
+                    gvt_done.wait(lock, [&] { return round != my_round; });
+                } else {
+                    T res = never;
+                    for (auto &q: processes) {
+                        res = std::min(res, q->next);
+                        std::lock_guard<std::mutex> inbox_lock(q->inbox_mutex);
+                        for (auto const &m: q->inbox) {
+                            res = std::min(res, m.time);
+                        }
+                    }
+                    gvt = res;
+                    // Every other LP is waiting, so their frames can be committed and their state logs merged here
+                    for (auto &q: processes) {
+                        commit(*q);
+                    }
+                    write_log();
+                    n_arrived = 0;
+                    n_frames = 0;
+                    gvt_requested = false;
+                    ++round;
+                    gvt_done.notify_all();
+                }
+            }
+        }
+
+        /// Commits the frames of the LP before the GVT: their state log is kept, and their saved values are discarded.
+        void commit(process &p) {
+            auto committed = std::find_if(p.frames.begin(), p.frames.end(), [this](frame const &f) { return f.time >= gvt; });
+            for (auto it = p.frames.begin(); it != committed; ++it) {
+                if (!it->log.empty()) {
+                    p.log.emplace_back(it->time, std::move(it->log));
+                }
+            }
+            p.frames.erase(p.frames.begin(), committed);
+            p.inputs.erase(p.inputs.begin(), p.inputs.lower_bound(gvt));
+        }
+
+        /**
+         * Writes the committed state logs of all the LPs, merged by time, and clears them. Committed frames are never
+         * rolled back, so their log is written at every GVT computation instead of being kept until the end of the run.
+         * LPs own contiguous ranges of cells, so they are written in order.
+         */
+        void write_log() {
+            std::vector<std::size_t> read(processes.size(), 0);
+            while (true) {
+                T t_log = never;
+                for (std::size_t k = 0; k < processes.size(); ++k) {
+                    if (read[k] < processes[k]->log.size()) {
+                        t_log = std::min(t_log, processes[k]->log[read[k]].first);
+                    }
+                }
+                if (t_log == never) {
+                    break;
+                }
+                state_log << t_log << "\n";
+                for (std::size_t k = 0; k < processes.size(); ++k) {
+                    if (read[k] < processes[k]->log.size() && processes[k]->log[read[k]].first == t_log) {
+                        state_log << processes[k]->log[read[k]++].second;
+                    }
+                }
+            }
+            for (auto &p: processes) {
+                p->log.clear();
+            }
+        }
+
+        /// Processes all the events of an LP that are scheduled before the given time.
+        void run_process(process &p, T t_end) {
+            while (true) {
+                if (gvt_requested.load(std::memory_order_acquire)) {
+                    synchronize(p);
+                    if (gvt >= t_end) {
+                        return;
+                    }
+                }
+                read_inbox(p);
+                T t = next_time(p);
+                // A frame whose transitions were undone can always be completed
+                bool full = p.frames.size() >= max_frames && p.frames.back().received;
+                bool idle = t >= t_end || full;
+                if (idle != p.idle) {
+                    p.idle = idle;
+                    idle? ++n_idle : --n_idle;
+                }
+                if (!idle) {
+                    process_time(p, t);
+                    continue;
+                }
+                // The GVT is computed when no LP can go on, or after every LP could have filled its frames again
+                if (n_idle.load() == processes.size() || n_frames.load(std::memory_order_relaxed) >= max_frames) {
+                    gvt_requested.store(true, std::memory_order_release);
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    public:
+        /**
+         * Creates a new optimistic runner. At the beginning of the simulation, every cell publishes its initial state.
+         * @param model lattice or graph to be simulated.
+         * @param state_log output stream for the state log.
+         * @param n_processes number of logical processes (each of them runs on its own thread).
+         * @param max_frames maximum number of uncommitted frames (i.e., of simulation times ahead of the GVT) of every LP.
+         * @param init_time initial simulation time.
+         */
+        optimistic_runner(M model, std::ostream &state_log, std::size_t n_processes = 1, std::size_t max_frames = 64,
+                          T init_time = 0) : model(std::move(model)), max_frames(std::max<std::size_t>(max_frames, 1)),
+                                             state_log(state_log), clock(init_time), gvt(init_time) {
+            auto n = this->model.states.size();
+            current = this->model.states;
+            published = current;
+            followers.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (auto const &neighbor: this->model.neighbors[i]) {
+                    followers[neighbor.first].push_back(i);
+                }
+            }
+            std::vector<std::size_t> all_cells(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                all_cells[i] = i;
+            }
+            owner.resize(n);
+            for (auto const &range: partition_by_edges(this->model.neighbors, all_cells, n_processes)) {
+                auto p = std::make_unique<process>();
+                p->first = range.first;
+                p->last = range.second;
+                p->outputs = std::make_unique<ordered_event_list<T>>(range.second - range.first);
+                for (auto i = range.first; i < range.second; ++i) {
+                    owner[i] = processes.size();
+                    p->outputs->push(init_time, i - range.first);
+                }
+                processes.push_back(std::move(p));
+            }
+            targets.resize(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                for (auto f: followers[i]) {
+                    if (owner[f] != owner[i]) {
+                        targets[i].push_back(owner[f]);
+                    }
+                }
+                std::sort(targets[i].begin(), targets[i].end());
+                targets[i].erase(std::unique(targets[i].begin(), targets[i].end()), targets[i].end());
+                for (auto t: targets[i]) {
+                    processes[t]->remote.emplace(i, current[i]);
+                }
+            }
+        }
+
+        /**
+         * Runs the simulation until the given time. Events scheduled at the given time are not processed.
+         * @param t simulation time at which the simulation stops.
+         * @return the given simulation time.
+         */
+        T run_until(T t) {
+            if (processes.empty()) {  // scenario without cells
+                clock = t;
+                return clock;
+            }
+            for (auto &p: processes) {
+                p->idle = false;
+            }
+            n_idle = 0;
+            std::vector<std::thread> threads;
+            for (std::size_t k = 1; k < processes.size(); ++k) {
+                threads.emplace_back([this, k, t] { run_process(*processes[k], t); });
+            }
+            run_process(*processes[0], t);
+            for (auto &thread: threads) {
+                thread.join();
+            }
+            write_log();
+            state_log.flush();
+            clock = t;
+            return clock;
+        }
+
+        /// @return current state of every cell of the scenario
+        [[nodiscard]] std::vector<S> const &states() const {
+            return current;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_OPTIMISTIC_RUNNER_HPP
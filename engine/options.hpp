@@ -0,0 +1,223 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_OPTIONS_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_OPTIONS_HPP
+
+#include <cmath>
+#include <string>
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace sim_engine {
+    /**
+     * Command line options shared by all the tutorial executables.
+     * Positional arguments are the scenario configuration file and the maximum simulation time.
+     * Flags starting with "--" select alternative execution modes and may appear anywhere.
+     */
+    struct run_options {
+        std::string config_path;    /// path to the JSON scenario configuration file
+        double sim_time = 500;      /// maximum simulation time
+        bool dense = false;         /// if true, lattice models with a constant output delay run as a dense array sweep
+        std::size_t threads = 1;    /// number of threads used by the engine runners
+        bool active = false;        /// if true, the engine runners only visit the cells around the latest state changes
+        bool blocked = false;       /// if true, dense runners advance bands of cells several ticks in a row
+        bool hybrid = false;        /// if true, dense runners sweep busy tiles and only visit the active cells of the rest
+        bool soa = false;           /// if true, cell states are stored as structures of arrays (one array per field)
+        bool packed = false;        /// if true, cell states are stored in fixed point instead of floats
+        bool conservative = false;  /// if true, cells are split in logical processes synchronized by their lookahead
+        bool optimistic = false;    /// if true, cells are split in logical processes that roll back on stragglers
+        double tolerance = 0;       /// if positive, cells hold back new states whose infected percentage barely changed
+        int max_delay = 4;          /// maximum output delay of cells with adaptive delays
+        bool lanes = false;         /// if true, ensembles pack several runs in the lanes of every cell
+        bool frozen_vicinity = false;   /// if true, the engine runners read edge weights computed once from the vicinities
+        double stop_below = 0;      /// if positive, runs stop when the infected fraction of the population is below it
+        std::size_t stop_steady = 0;  /// if positive, runs stop after this number of ticks without state changes
+        std::string checkpoint_path;  /// if not empty, path of the file where the engine runners write checkpoints
+        double checkpoint_every = 100;  /// simulation time between consecutive checkpoints
+        std::string restore_path;   /// if not empty, path of the checkpoint from which the simulation is resumed
+        std::string history_path;   /// if not empty, path of the history of a previous run that incremental runs reuse
+        double fork_at = 0;         /// simulation time at which branch studies fork the simulation
+        std::size_t processes = 1;  /// number of processes that simulate a tile of the lattice each
+        int port = 47000;           /// first localhost port used by the processes to exchange halos
+
+        /// @return true if the user selected any of the engine runners instead of the Cadmium runner
+        [[nodiscard]] bool uses_engine() const {
+            return dense || active || hybrid || blocked || soa || packed || conservative || optimistic || tolerance > 0 || threads > 1 || processes > 1 || stop_below > 0 ||
+                   stop_steady > 0 || frozen_vicinity || !checkpoint_path.empty() || !restore_path.empty() || !history_path.empty();
+        }
+    };
+
+    /**
+     * Checks whether a simulation time read from the command line is a whole number of ticks. Executables built with
+     * CELLDEVS_TICK_TIME (see TICK_TIME_TARGETS) represent the simulation time as an integer number of ticks.
+     * @param t simulation time.
+     * @return true if the executable represents the simulation time exactly.
+     */
+    bool representable_time(double t) {
+#ifdef CELLDEVS_TICK_TIME
+        return t == std::floor(t);
+#else
+        return true;
+#endif
+    }
+
+    /**
+     * Parses the command line arguments of a tutorial executable.
+     * @param argc number of command line arguments
+     * @param argv command line arguments
+     * @return options selected by the user
+     * @throw std::invalid_argument if the arguments are not valid
+     */
+    run_options parse_options(int argc, char **argv) {
+        run_options res;
+        int n_positional = 0;
+        bool every = false;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg == "--dense") {
+                res.dense = true;
+            } else if (arg == "--active") {
+                res.active = true;
+            } else if (arg == "--blocked") {
+                res.blocked = true;
+            } else if (arg == "--hybrid") {
+                res.hybrid = true;
+            } else if (arg == "--soa") {
+                res.soa = true;
+            } else if (arg == "--packed") {
+                res.packed = true;
+            } else if (arg == "--conservative") {
+                res.conservative = true;
+            } else if (arg == "--optimistic") {
+                res.optimistic = true;
+            } else if (arg == "--lanes") {
+                res.lanes = true;
+            } else if (arg == "--frozen-vicinity") {
+                res.frozen_vicinity = true;
+            } else if (arg == "--threads") {
+                if (++i == argc || std::atoi(argv[i]) < 1) {
+                    throw std::invalid_argument("--threads requires a positive number of threads");
+                }
+                res.threads = std::atoi(argv[i]);
+            } else if (arg == "--tolerance") {
+                if (++i == argc || std::atof(argv[i]) <= 0) {
+                    throw std::invalid_argument("--tolerance requires a positive relative change");
+                }
+                res.tolerance = std::atof(argv[i]);
+            } else if (arg == "--max-delay") {
+                if (++i == argc || std::atoi(argv[i]) < 1) {
+                    throw std::invalid_argument("--max-delay requires a positive number of ticks");
+                }
+                res.max_delay = std::atoi(argv[i]);
+            } else if (arg == "--stop-below") {
+                if (++i == argc || std::atof(argv[i]) <= 0) {
+                    throw std::invalid_argument("--stop-below requires a positive fraction");
+                }
+                res.stop_below = std::atof(argv[i]);
+            } else if (arg == "--stop-steady") {
+                if (++i == argc || std::atoi(argv[i]) < 1) {
+                    throw std::invalid_argument("--stop-steady requires a positive number of ticks");
+                }
+                res.stop_steady = std::atoi(argv[i]);
+            } else if (arg == "--checkpoint") {
+                if (++i == argc) {
+                    throw std::invalid_argument("--checkpoint requires a file path");
+                }
+                res.checkpoint_path = argv[i];
+            } else if (arg == "--checkpoint-every") {
+                // All the models advance whole ticks, so shorter intervals would never advance the simulation
+                if (++i == argc || std::atof(argv[i]) < 1 || !representable_time(std::atof(argv[i]))) {
+                    throw std::invalid_argument("--checkpoint-every requires at least one tick (and a whole number of ticks with integer time)");
+                }
+                res.checkpoint_every = std::atof(argv[i]);
+                every = true;
+            } else if (arg == "--restore") {
+                if (++i == argc || !std::ifstream(argv[i], std::ios::binary).is_open()) {
+                    throw std::invalid_argument("--restore requires the path of an existing checkpoint");
+                }
+                res.restore_path = argv[i];
+            } else if (arg == "--history") {
+                if (++i == argc) {
+                    throw std::invalid_argument("--history requires a file path");
+                }
+                res.history_path = argv[i];
+            } else if (arg == "--fork-at") {
+                if (++i == argc || std::atof(argv[i]) <= 0) {
+                    throw std::invalid_argument("--fork-at requires a positive simulation time");
+                }
+                res.fork_at = std::atof(argv[i]);
+            } else if (arg == "--processes") {
+                if (++i == argc || std::atoi(argv[i]) < 1) {
+                    throw std::invalid_argument("--processes requires a positive number of processes");
+                }
+                res.processes = std::atoi(argv[i]);
+            } else if (arg == "--port") {
+                if (++i == argc || std::atoi(argv[i]) < 1) {
+                    throw std::invalid_argument("--port requires a port number");
+                }
+                res.port = std::atoi(argv[i]);
+            } else if (arg.rfind("--", 0) == 0) {
+                throw std::invalid_argument("unknown option " + arg);
+            } else if (n_positional == 0) {
+                res.config_path = arg;
+                n_positional++;
+            } else if (n_positional == 1) {
+                res.sim_time = std::atof(arg.c_str());
+                n_positional++;
+            } else throw std::invalid_argument("unexpected argument " + arg);
+        }
+        if (n_positional == 0) {
+            throw std::invalid_argument("scenario configuration file is missing");
+        }
+        if (res.sim_time < 0 || !representable_time(res.sim_time)) {
+            throw std::invalid_argument("the maximum simulation time cannot be negative (and must be a whole number of ticks with integer time)");
+        }
+        if (res.processes > 1 && res.threads > 1) {
+            throw std::invalid_argument("--threads cannot be combined with --processes (every process simulates its tile in one thread)");
+        }
+        if (every && res.checkpoint_path.empty()) {
+            throw std::invalid_argument("--checkpoint-every requires --checkpoint");
+        }
+        // Only the dense runner writes and restores checkpoints, and evaluates termination predicates
+        bool other_runner = res.soa || res.packed || res.conservative || res.optimistic || res.tolerance > 0 || res.processes > 1 ||
+                            !res.history_path.empty();
+        if (other_runner && (!res.checkpoint_path.empty() || !res.restore_path.empty())) {
+            throw std::invalid_argument("--checkpoint and --restore cannot be combined with other runners than the dense one");
+        }
+        if (res.frozen_vicinity && !res.restore_path.empty()) {
+            throw std::invalid_argument("--frozen-vicinity cannot be combined with --restore (checkpoints keep the edge weights of the interrupted run)");
+        }
+        if (other_runner && (res.stop_below > 0 || res.stop_steady > 0)) {
+            throw std::invalid_argument("--stop-below and --stop-steady cannot be combined with other runners than the dense one");
+        }
+        return res;
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_OPTIONS_HPP
@@ -0,0 +1,182 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_SCENARIO_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_SCENARIO_HPP
+
+#include <string>
+#include <fstream>
+#include <utility>
+#include <type_traits>
+#include <nlohmann/json.hpp>
+
+namespace sim_engine {
+    /**
+     * Reads a JSON scenario configuration file.
+     * @param file_path path to the JSON file
+     * @return parsed JSON scenario configuration
+     */
+    nlohmann::json read_json(std::string const &file_path) {
+        std::ifstream i(file_path);
+        nlohmann::json j;
+        i >> j;
+        return j;
+    }
+
+    /**
+     * Cells of a scenario are configured with the default configuration overridden by their specific configuration.
+     * @param j JSON scenario configuration
+     * @param name name of the cell configuration
+     * @return merged configuration of the cells with the given name
+     */
+    nlohmann::json cell_spec_json(nlohmann::json const &j, std::string const &name) {
+        nlohmann::json res = j.at("cells").at("default");
+        if (name != "default") {
+            res.merge_patch(j.at("cells").at(name));
+        }
+        return res;
+    }
+
+    /**
+     * @param patch JSON value of a configuration that overrides the default configuration.
+     * @return true if the value has a member (or a member of a member) set to null (i.e., that removes a default field).
+     */
+    bool has_null_member(nlohmann::json const &patch) {
+        if (patch.is_object()) {
+            for (auto const &value: patch) {
+                if (value.is_null() || has_null_member(value)) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Reads one field of the merged configuration of a cell (i.e., cell_spec_json(j, name).at(key)) without merging
+     * the rest of the configuration. A field that only the default or the specific configuration of the cell defines
+     * is returned without copying it. Agent scenarios define a specific neighborhood for every cell, so this avoids a
+     * copy of the whole cell configuration per cell.
+     * @param j JSON scenario configuration
+     * @param name name of the cell configuration
+     * @param key name of the field
+     * @param merged storage of the field if it had to be merged
+     * @return merged field
+     */
+    nlohmann::json const &cell_spec_field(nlohmann::json const &j, std::string const &name, std::string const &key,
+                                          nlohmann::json &merged) {
+        auto const &base = j.at("cells").at("default");
+        auto const &cell = j.at("cells").at(name);
+        auto patch = cell.find(key);
+        if (name == "default" || patch == cell.end()) {
+            return base.at(key);
+        }
+        if (!patch->is_object() && !patch->is_null()) {
+            return *patch;  // values other than objects replace the default value
+        }
+        auto default_value = base.find(key);
+        if (patch->is_object() && !has_null_member(*patch) &&
+                (default_value == base.end() || !default_value->is_object() || default_value->empty())) {
+            return *patch;  // there is nothing to merge
+        }
+        merged = cell_spec_json(j, name).at(key);
+        return merged;
+    }
+
+    /**
+     * A kernel is the side-effect-free version of a cell model. It must define:
+     *   - state_type, vicinity_type and config_type: the cell state, vicinity, and configuration structs.
+     *   - cell_type: the cell type string used in the JSON scenario file.
+     *   - neighbor_contribution(state, vicinity): contribution of one neighbor to the cell's transition.
+     *   - local_computation(state, aggregate, config): new cell state given the sum of all the neighbor contributions.
+     * Kernels whose neighbor contributions only depend on a coefficient derived from the vicinity may also define an
+     * edge_weight(vicinity) function that computes it, and a neighbor_contribution(state, weight) overload. Vicinities
+     * never change, so lattices and graphs compute the weight of every edge once (see has_edge_weight).
+     * Kernels with a constant output delay must also define an output_delay constant. Otherwise, they must define an
+     * output_delay(state, config) or output_delay(published, state, config) function, where published is the latest
+     * state that the cell published, and a lookahead constant that is a strictly positive lower bound of it.
+     * This trait detects whether a kernel has a constant output delay.
+     */
+    template <typename K, typename = void>
+    struct has_constant_delay : std::false_type {};
+
+    template <typename K>
+    struct has_constant_delay<K, std::enable_if_t<!std::is_function<decltype(K::output_delay)>::value>> : std::true_type {};
+
+    /// This trait detects whether a kernel folds the vicinities into edge weights.
+    template <typename K, typename = void>
+    struct has_edge_weight : std::false_type {};
+
+    template <typename K>
+    struct has_edge_weight<K, std::void_t<decltype(K::edge_weight(std::declval<typename K::vicinity_type>()))>> : std::true_type {};
+
+    /**
+     * @param v vicinity between a cell and one of its neighbors.
+     * @return weight of the edge (or the vicinity itself, if the kernel does not define edge weights).
+     */
+    template <typename K>
+    auto kernel_edge_weight(typename K::vicinity_type const &v) {
+        if constexpr (has_edge_weight<K>::value) {
+            return K::edge_weight(v);
+        } else {
+            return v;
+        }
+    }
+
+    /// Type of the edge weights of a kernel (its vicinity type, if the kernel does not define edge weights).
+    template <typename K>
+    using edge_weight_type = decltype(kernel_edge_weight<K>(std::declval<typename K::vicinity_type>()));
+
+    /**
+     * @param p latest state published by a cell.
+     * @param s new state of the cell.
+     * @param c configuration of the cell.
+     * @return time that the cell waits before publishing its new state.
+     */
+    template <typename T, typename K>
+    T kernel_delay(typename K::state_type const &p, typename K::state_type const &s, typename K::config_type const &c) {
+        if constexpr (has_constant_delay<K>::value) {
+            return K::output_delay;
+        } else if constexpr (std::is_invocable<decltype(&K::output_delay), decltype(p), decltype(s), decltype(c)>::value) {
+            return K::output_delay(p, s, c);
+        } else {
+            return K::output_delay(s, c);
+        }
+    }
+
+    /// @return minimum time that any cell of a kernel waits before publishing a new state.
+    template <typename T, typename K>
+    T kernel_lookahead() {
+        if constexpr (has_constant_delay<K>::value) {
+            return K::output_delay;
+        } else {
+            return K::lookahead;
+        }
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_SCENARIO_HPP
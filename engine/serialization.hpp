@@ -0,0 +1,160 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_SERIALIZATION_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_SERIALIZATION_HPP
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <utility>
+#include <stdexcept>
+#include <type_traits>
+#include "adjacency.hpp"
+
+namespace sim_engine {
+    /**
+     * Functions for writing and reading the engine data structures in a compact binary format.
+     * Values are written as raw bytes, so binary files are only portable between builds with the same data types.
+     * Readers throw std::runtime_error if the stream ends before the expected data.
+     */
+    template <typename X>
+    void write_binary(std::ostream &os, X const &x) {
+        static_assert(std::is_trivially_copyable<X>::value, "only trivially copyable values can be written as raw bytes");
+        os.write(reinterpret_cast<char const *>(&x), sizeof(X));
+    }
+
+    template <typename X>
+    void read_binary(std::istream &is, X &x) {
+        static_assert(std::is_trivially_copyable<X>::value, "only trivially copyable values can be read as raw bytes");
+        if (!is.read(reinterpret_cast<char *>(&x), sizeof(X))) {
+            throw std::runtime_error("unexpected end of binary data");
+        }
+    }
+
+    template <typename X>
+    void write_binary(std::ostream &os, std::vector<X> const &v) {
+        static_assert(std::is_trivially_copyable<X>::value, "only trivially copyable values can be written as raw bytes");
+        write_binary(os, (std::uint64_t) v.size());
+        os.write(reinterpret_cast<char const *>(v.data()), (std::streamsize) (v.size() * sizeof(X)));
+    }
+
+    template <typename X>
+    void read_binary(std::istream &is, std::vector<X> &v) {
+        static_assert(std::is_trivially_copyable<X>::value, "only trivially copyable values can be read as raw bytes");
+        std::uint64_t size;
+        read_binary(is, size);
+        v.resize(size);
+        if (!is.read(reinterpret_cast<char *>(v.data()), (std::streamsize) (size * sizeof(X)))) {
+            throw std::runtime_error("unexpected end of binary data");
+        }
+    }
+
+    void write_binary(std::ostream &os, std::string const &s) {
+        write_binary(os, std::vector<char>(s.begin(), s.end()));
+    }
+
+    void read_binary(std::istream &is, std::string &s) {
+        std::vector<char> chars;
+        read_binary(is, chars);
+        s.assign(chars.begin(), chars.end());
+    }
+
+    void write_binary(std::ostream &os, std::vector<std::string> const &v) {
+        write_binary(os, (std::uint64_t) v.size());
+        for (auto const &s: v) {
+            write_binary(os, s);
+        }
+    }
+
+    void read_binary(std::istream &is, std::vector<std::string> &v) {
+        std::uint64_t size;
+        read_binary(is, size);
+        v.resize(size);
+        for (auto &s: v) {
+            read_binary(is, s);
+        }
+    }
+
+    /// Neighbor lists are written as offsets, neighbor indices, and vicinities (as their CSR arrays).
+    template <typename V>
+    void write_binary(std::ostream &os, adjacency<V> const &neighbors) {
+        std::vector<std::uint64_t> offsets(neighbors.row_offsets().begin(), neighbors.row_offsets().end());
+        std::vector<std::uint64_t> indices(neighbors.neighbor_indices().begin(), neighbors.neighbor_indices().end());
+        write_binary(os, offsets);
+        write_binary(os, indices);
+        write_binary(os, neighbors.neighbor_vicinities());
+    }
+
+    template <typename V>
+    void read_binary(std::istream &is, adjacency<V> &neighbors) {
+        std::vector<std::uint64_t> offsets, indices;
+        std::vector<V> vicinities;
+        read_binary(is, offsets);
+        read_binary(is, indices);
+        read_binary(is, vicinities);
+        if (offsets.empty() || offsets.back() != indices.size() || indices.size() != vicinities.size()) {
+            throw std::runtime_error("inconsistent neighbor lists");
+        }
+        neighbors = adjacency<V>({offsets.begin(), offsets.end()}, {indices.begin(), indices.end()}, std::move(vicinities));
+    }
+
+    /**
+     * Writes the header of a binary file.
+     * @param os output stream.
+     * @param kind kind of data stored in the file.
+     */
+    void write_header(std::ostream &os, std::string const &kind) {
+        os.write("CELLDEVS", 8);
+        write_binary(os, kind);
+        write_binary(os, (std::uint32_t) 1);  // format version
+    }
+
+    /**
+     * Checks the header of a binary file.
+     * @param is input stream.
+     * @param kind expected kind of data.
+     * @throw std::runtime_error if the file does not contain the expected kind of data.
+     */
+    void check_header(std::istream &is, std::string const &kind) {
+        char magic[8];
+        if (!is.read(magic, 8) || std::string(magic, 8) != "CELLDEVS") {
+            throw std::runtime_error("binary file does not contain a " + kind);
+        }
+        std::string file_kind;
+        std::uint32_t version;
+        read_binary(is, file_kind);
+        read_binary(is, version);
+        if (file_kind != kind || version != 1) {
+            throw std::runtime_error("binary file does not contain a " + kind);
+        }
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_SERIALIZATION_HPP
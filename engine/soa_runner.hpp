@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_SOA_RUNNER_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_SOA_RUNNER_HPP
+
+#include <memory>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <ostream>
+#include <utility>
+#include "graph.hpp"
+#include "lattice.hpp"
+#include "thread_pool.hpp"
+#include "work_stealing.hpp"
+
+namespace sim_engine {
+    /**
+     * Dense lockstep runner for kernels that store the states of the cells as a structure of arrays.
+     * It advances the scenario as the dense schedule of the dense runner, and writes the same state log. However, cell
+     * states are not stored as an array of state structs: every field has its own contiguous array, and cells read the
+     * states of their neighbors through views that only load the fields that the kernel actually reads. Thus, a sweep
+     * streams a few arrays instead of whole state structs, and the compiler sees plain arrays of numbers.
+     *
+     * Kernels must define a state_arrays type (e.g., sird_arrays) with:
+     *   - a constructor from a vector of states, and a size() method.
+     *   - operator[](i), which returns a view of the state of cell i. Views convert to state_type, and
+     *     neighbor_contribution must accept them as the neighbor state.
+     *   - set(i, state), which overwrites the state of cell i.
+     * @tparam T data type used to represent the simulation time.
+     * @tparam K kernel of the cells. It must have a constant output delay.
+     * @tparam M flat scenario representation (lattice or graph).
+     */
+    template <typename T, typename K, typename M = lattice<K>>
+    class soa_runner {
+        static_assert(has_constant_delay<K>::value, "soa_runner requires a kernel with a constant output delay");
+        using S = typename K::state_type;
+        using C = typename K::config_type;
+        using R = typename K::state_arrays;
+        using A = decltype(K::neighbor_contribution(std::declval<S>(), std::declval<typename K::vicinity_type>()));
+
+        M model;                                /// scenario topology and cell configurations
+        R current;                              /// current (and latest published) state of every cell
+        R next;                                 /// back buffer for the states computed in the current tick
+        std::vector<char> published;            /// cells that publish their state in the current tick
+        std::vector<char> changed;              /// cells whose state changed in the current tick
+        std::ostream &state_log;                /// output stream for the state log
+        T clock;                                /// current simulation time
+        std::unique_ptr<thread_pool> pool;      /// thread pool for sweeping the cells in parallel (if any)
+        std::vector<cell_range> tasks;          /// ranges of cells with roughly the same number of edges
+
+        /// Computes the next state of a range of cells, and writes the state log of the cells involved in the tick.
+        void sweep(cell_range range, std::ostream &log) {
+            for (auto i = range.first; i < range.second; ++i) {
+                bool imminent = false;
+                for (auto const &neighbor: model.neighbors[i]) {
+                    imminent |= (bool) published[neighbor.first];
+                }
+                S state = current[i];
+                changed[i] = false;
+                if (imminent) {
+                    A aux = model.visit_neighbors(i, [&](auto const &row) {
+                        A res = 0;
+                        for (auto const &[neighbor, weight]: row) {
+                            res += K::neighbor_contribution(current[neighbor], weight);
+                        }
+                        return res;
+                    });
+                    auto candidate = K::local_computation(state, aux, model.configs[i]);
+                    if (candidate != state) {
+                        state = candidate;
+                        changed[i] = true;
+                    }
+                }
+                next.set(i, state);
+                if (imminent || published[i]) {
+                    log << "State for model " << model.cell_id(i) << " is " << state << "\n";
+                }
+            }
+        }
+    public:
+        /**
+         * Creates a new runner. At the beginning of the simulation, every cell publishes its initial state.
+         * @param model lattice or graph to be simulated.
+         * @param state_log output stream for the state log.
+         * @param n_threads number of threads that sweep the cells.
+         * @param init_time initial simulation time.
+         */
+        soa_runner(M model, std::ostream &state_log, std::size_t n_threads = 1, T init_time = 0) :
+                model(std::move(model)), current(this->model.states), next(this->model.states), state_log(state_log),
+                clock(init_time) {
+            auto n = current.size();
+            published = std::vector<char>(n, true);
+            changed = std::vector<char>(n, false);
+            std::vector<std::size_t> all_cells(n);
+            for (std::size_t i = 0; i < n; ++i) {
+                all_cells[i] = i;
+            }
+            tasks = partition_by_edges(this->model.neighbors, all_cells, n_threads > 1? 4 * n_threads : 1);
+            if (n_threads > 1) {
+                pool = std::make_unique<thread_pool>(n_threads);
+            }
+        }
+
+        /**
+         * Runs the simulation until the given time.
+         * @param t simulation time at which the simulation stops.
+         * @return the time of the next tick.
+         */
+        T run_until(T t) {
+            while (clock < t) {
+                step();
+            }
+            return clock;
+        }
+
+        /// Advances the scenario one tick.
+        void step() {
+            if (std::none_of(published.begin(), published.end(), [](char p) { return p; })) {
+                // No cell receives a new neighbor state, so no cell is imminent and Cadmium would not log this tick
+                clock += K::output_delay;
+                return;
+            }
+            state_log << clock << std::endl;
+            if (pool == nullptr) {
+                sweep({0, current.size()}, state_log);
+            } else {
+                // Every range logs into its own buffer. Buffers are written in order after the sweep
+                std::vector<std::ostringstream> logs(tasks.size());
+                pool->parallel_for(tasks.size(), [&](std::size_t k) {
+                    sweep(tasks[k], logs[k]);
+                });
+                for (auto const &log: logs) {
+                    state_log << log.str();
+                }
+            }
+            std::swap(current, next);
+            std::swap(published, changed);
+            clock += K::output_delay;
+        }
+
+        /// @return current state of every cell, as a structure of arrays
+        [[nodiscard]] R const &states() const {
+            return current;
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_SOA_RUNNER_HPP
@@ -0,0 +1,274 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_TERMINATION_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_TERMINATION_HPP
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <utility>
+#include <functional>
+#include <stdexcept>
+#include "options.hpp"
+#include "serialization.hpp"
+
+namespace sim_engine {
+    /**
+     * Predicate that tells a runner to stop before the maximum simulation time (e.g., when the outcome is fixed).
+     * Runners evaluate it incrementally: they only report the cells that changed their state in every tick.
+     * @tparam S cell state type.
+     */
+    template <typename S>
+    class termination {
+    public:
+        virtual ~termination() = default;
+
+        /**
+         * Called by the runner before the first tick.
+         * @param states current state of every cell.
+         */
+        virtual void start(std::vector<S> const &states) {}
+
+        /**
+         * Called by the runner for every cell that changes its state.
+         * @param previous previous state of the cell.
+         * @param current new state of the cell.
+         */
+        virtual void update(S const &previous, S const &current) {}
+
+        /**
+         * Called by the runner at the end of every tick.
+         * @param n_changed number of cells that changed their state in the tick.
+         * @return true if the simulation must stop.
+         */
+        virtual bool done(std::size_t n_changed) = 0;
+
+        /// @return true if the predicate is never fulfilled (runners may then skip the per-tick bookkeeping)
+        [[nodiscard]] virtual bool never() const {
+            return false;
+        }
+
+        /**
+         * Writes the state of the predicate (e.g., in a checkpoint), so a restored run continues evaluating it instead
+         * of starting it over.
+         * @param os output stream.
+         */
+        virtual void save(std::ostream &os) const {}
+
+        /**
+         * Reads the state of the predicate written by save, instead of starting it.
+         * @param is input stream.
+         * @throw std::runtime_error if the stream contains the state of another kind of predicate.
+         */
+        virtual void load(std::istream &is) {}
+
+    protected:
+        /// Writes the kind of a predicate before its state
+        static void save_kind(std::ostream &os, std::string const &kind) {
+            write_binary(os, kind);
+        }
+
+        /// Checks that a predicate state written by save belongs to the same kind of predicate
+        static void load_kind(std::istream &is, std::string const &kind) {
+            std::string saved;
+            read_binary(is, saved);
+            if (saved != kind) {
+                throw std::runtime_error("the termination predicates differ from the ones of the interrupted run");
+            }
+        }
+    };
+
+    /// Stops the simulation after a number of consecutive ticks without any cell state change.
+    template <typename S>
+    class steady_state : public termination<S> {
+        std::size_t n_ticks;    /// number of ticks without changes required for stopping
+        std::size_t idle = 0;   /// number of consecutive ticks without changes
+    public:
+        explicit steady_state(std::size_t n_ticks) : n_ticks(n_ticks) {}
+
+        void start(std::vector<S> const &states) override {
+            idle = 0;
+        }
+
+        bool done(std::size_t n_changed) override {
+            idle = (n_changed == 0)? idle + 1 : 0;
+            return idle >= n_ticks;
+        }
+
+        void save(std::ostream &os) const override {
+            this->save_kind(os, "steady_state");
+            write_binary(os, (std::uint64_t) idle);
+        }
+
+        void load(std::istream &is) override {
+            this->load_kind(is, "steady_state");
+            std::uint64_t saved;
+            read_binary(is, saved);
+            idle = saved;
+        }
+    };
+
+    /**
+     * Stops the simulation when a global fraction drops below a threshold (e.g., the infected fraction of the whole
+     * population). The numerator and the denominator are sums over all the cells, and they are updated incrementally.
+     * Contributions are rounded to multiples of a fixed quantum and added up as integers. Integer sums are exact, so
+     * they do not depend on the order in which runners report state changes (i.e., on the schedule or the number of
+     * threads), and incremental updates never drift away from the sum over all the cells.
+     */
+    template <typename S>
+    class fraction_below : public termination<S> {
+        static constexpr double quantum = 1. / 1024;    /// resolution of the contributions of the cells
+
+        std::function<double(S const &)> numerator;     /// contribution of a cell to the numerator
+        std::function<double(S const &)> denominator;   /// contribution of a cell to the denominator
+        double epsilon;                                 /// the simulation stops when the fraction is below epsilon
+        std::int64_t num = 0, den = 0;                  /// current sums over all the cells (in quanta)
+
+        static std::int64_t quantize(double x) {
+            return std::llround(x / quantum);
+        }
+    public:
+        fraction_below(std::function<double(S const &)> numerator, std::function<double(S const &)> denominator,
+                       double epsilon) : numerator(std::move(numerator)), denominator(std::move(denominator)),
+                                         epsilon(epsilon) {}
+
+        void start(std::vector<S> const &states) override {
+            num = den = 0;
+            for (auto const &s: states) {
+                num += quantize(numerator(s));
+                den += quantize(denominator(s));
+            }
+        }
+
+        void update(S const &previous, S const &current) override {
+            num += quantize(numerator(current)) - quantize(numerator(previous));
+            den += quantize(denominator(current)) - quantize(denominator(previous));
+        }
+
+        bool done(std::size_t n_changed) override {
+            return den > 0 && (double) num / (double) den < epsilon;
+        }
+
+        void save(std::ostream &os) const override {
+            this->save_kind(os, "fraction_below");
+            write_binary(os, num);
+            write_binary(os, den);
+        }
+
+        void load(std::istream &is) override {
+            this->load_kind(is, "fraction_below");
+            read_binary(is, num);
+            read_binary(is, den);
+        }
+    };
+
+    /// Stops the simulation as soon as any of several predicates is fulfilled.
+    template <typename S>
+    class any_of : public termination<S> {
+        std::vector<std::unique_ptr<termination<S>>> predicates;
+    public:
+        void add(std::unique_ptr<termination<S>> predicate) {
+            predicates.push_back(std::move(predicate));
+        }
+
+        [[nodiscard]] bool empty() const {
+            return predicates.empty();
+        }
+
+        [[nodiscard]] bool never() const override {
+            return std::all_of(predicates.begin(), predicates.end(), [](auto const &p) { return p->never(); });
+        }
+
+        void start(std::vector<S> const &states) override {
+            for (auto &p: predicates) {
+                p->start(states);
+            }
+        }
+
+        void update(S const &previous, S const &current) override {
+            for (auto &p: predicates) {
+                p->update(previous, current);
+            }
+        }
+
+        bool done(std::size_t n_changed) override {
+            bool res = false;
+            for (auto &p: predicates) {
+                res |= p->done(n_changed);  // every predicate sees every tick
+            }
+            return res;
+        }
+
+        void save(std::ostream &os) const override {
+            this->save_kind(os, "any_of");
+            write_binary(os, (std::uint64_t) predicates.size());
+            for (auto const &p: predicates) {
+                p->save(os);
+            }
+        }
+
+        void load(std::istream &is) override {
+            this->load_kind(is, "any_of");
+            std::uint64_t size;
+            read_binary(is, size);
+            if (size != predicates.size()) {
+                throw std::runtime_error("the termination predicates differ from the ones of the interrupted run");
+            }
+            for (auto &p: predicates) {
+                p->load(is);
+            }
+        }
+    };
+
+    /**
+     * Builds the termination predicates selected in the command line for the epidemic states of the tutorials.
+     * @tparam S cell state type. It must have the population and infected fields.
+     * @param options options selected by the user.
+     * @return predicate that is fulfilled when any of the selected predicates is fulfilled (never if none is selected).
+     */
+    template <typename S>
+    std::unique_ptr<termination<S>> stop_conditions(run_options const &options) {
+        auto res = std::make_unique<any_of<S>>();
+        if (options.stop_below > 0) {
+            res->add(std::make_unique<fraction_below<S>>([](S const &s) {
+                return (double) s.infected * s.population;
+            }, [](S const &s) {
+                return (double) s.population;
+            }, options.stop_below));
+        }
+        if (options.stop_steady > 0) {
+            res->add(std::make_unique<steady_state<S>>(options.stop_steady));
+        }
+        return res;
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_TERMINATION_HPP
@@ -0,0 +1,184 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_THREAD_POOL_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_THREAD_POOL_HPP
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include "numa.hpp"
+
+namespace sim_engine {
+    /**
+     * Fixed-size pool of worker threads that execute batches of independent jobs.
+     * The thread that submits a batch also executes jobs, so a pool of N threads only spawns N - 1 workers.
+     * Threads may be pinned to CPUs (e.g., to keep every thread close to the memory of the cells that it owns).
+     */
+    class thread_pool {
+        /// Batch of jobs submitted by a single call to parallel_for
+        struct batch {
+            std::function<void(std::size_t)> job;   /// function to be executed for each job index
+            std::size_t n_jobs;                     /// number of jobs in the batch
+            bool per_thread;                        /// every thread executes the job with its own index
+            std::atomic<std::size_t> next_job;      /// index of the next job to be claimed by a thread
+            std::atomic<std::size_t> pending;       /// number of jobs that have not finished yet
+            batch(std::function<void(std::size_t)> job, std::size_t n_jobs, bool per_thread) : job(std::move(job)),
+                    n_jobs(n_jobs), per_thread(per_thread), next_job(0), pending(n_jobs) {}
+        };
+
+        std::vector<std::thread> workers;
+        std::vector<int> cpus;                  /// CPU of every thread (empty if threads are not pinned)
+        std::vector<int> caller_affinity;       /// CPUs of the thread that created the pool before pinning it
+        std::mutex mutex;
+        std::condition_variable batch_ready;
+        std::condition_variable batch_done;
+        std::shared_ptr<batch> current;
+        std::size_t generation = 0;
+        bool stopping = false;
+
+        void finish(batch &b) {
+            if (--b.pending == 0) {
+                { std::lock_guard<std::mutex> lock(mutex); }
+                batch_done.notify_all();
+            }
+        }
+
+        void run(batch &b, std::size_t self) {
+            if (b.per_thread) {
+                b.job(self);
+                finish(b);
+                return;
+            }
+            for (std::size_t j = b.next_job++; j < b.n_jobs; j = b.next_job++) {
+                b.job(j);
+                finish(b);
+            }
+        }
+
+        void work(std::size_t self) {
+            if (!cpus.empty()) {
+                set_thread_affinity({cpus[self]});
+            }
+            std::size_t seen = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                batch_ready.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping) {
+                    return;
+                }
+                seen = generation;
+                auto b = current;  // workers that wake up late only see an exhausted batch
+                lock.unlock();
+                run(*b, self);
+                lock.lock();
+            }
+        }
+
+        void submit(std::shared_ptr<batch> const &b) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                current = b;
+                generation++;
+            }
+            batch_ready.notify_all();
+            run(*b, 0);
+            std::unique_lock<std::mutex> lock(mutex);
+            batch_done.wait(lock, [&] { return b->pending == 0; });
+        }
+    public:
+        /**
+         * Creates a new thread pool.
+         * @param n_threads total number of threads that execute jobs (including the caller of parallel_for).
+         * @param cpus CPU of every thread (none to let the operating system move threads). Thread 0 is the thread
+         * that creates the pool, and it gets its previous affinity back when the pool is destroyed.
+         */
+        explicit thread_pool(std::size_t n_threads, std::vector<int> cpus = {}) : cpus(std::move(cpus)) {
+            if (!this->cpus.empty()) {
+                caller_affinity = thread_affinity();
+                set_thread_affinity({this->cpus[0]});
+            }
+            for (std::size_t i = 1; i < n_threads; ++i) {
+                workers.emplace_back([this, i] { work(i); });
+            }
+        }
+
+        thread_pool(thread_pool const &) = delete;
+        thread_pool &operator=(thread_pool const &) = delete;
+
+        ~thread_pool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            batch_ready.notify_all();
+            for (auto &w: workers) {
+                w.join();
+            }
+            set_thread_affinity(caller_affinity);
+        }
+
+        /// @return total number of threads that execute jobs
+        [[nodiscard]] std::size_t size() const {
+            return workers.size() + 1;
+        }
+
+        /// @return true if every thread is pinned to a CPU
+        [[nodiscard]] bool pinned() const {
+            return !cpus.empty();
+        }
+
+        /**
+         * Executes job(0), ..., job(n_jobs - 1) in parallel and waits until all of them have finished.
+         * Jobs are claimed dynamically, so submitting more jobs than threads balances uneven workloads.
+         * @param n_jobs number of jobs.
+         * @param job function to be executed for each job index.
+         */
+        void parallel_for(std::size_t n_jobs, std::function<void(std::size_t)> job) {
+            if (n_jobs == 0) {
+                return;
+            }
+            submit(std::make_shared<batch>(std::move(job), n_jobs, false));
+        }
+
+        /**
+         * Executes job(k) on the k-th thread of the pool for every thread, and waits until all of them have finished.
+         * Thread 0 is the caller, and every other thread always gets the same index (e.g., for binding data to
+         * threads and, if the pool is pinned, to the NUMA node of their CPU).
+         * @param job function to be executed by every thread with the thread index.
+         */
+        void on_each_thread(std::function<void(std::size_t)> job) {
+            submit(std::make_shared<batch>(std::move(job), size(), true));
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_THREAD_POOL_HPP
@@ -0,0 +1,121 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_TICK_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_TICK_HPP
+
+#include <limits>
+#include <cstdint>
+#include <ostream>
+
+namespace sim_engine {
+    /**
+     * Integral simulation time for models whose delays are whole ticks.
+     * Unlike float, it represents every tick exactly (float loses precision past 2^24 ticks), and comparisons are
+     * integer comparisons. Cadmium passivates models with an infinite time advance, so the maximum value of the type
+     * represents infinity, and additions and subtractions involving infinity saturate.
+     * Select it in an executable with "using TIME = sim_engine::tick;".
+     */
+    struct tick {
+        static constexpr std::uint64_t infinite = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t value;    /// number of ticks since the beginning of the simulation
+
+        constexpr tick(std::uint64_t value = 0) : value(value) {}  // NOLINT: implicit so delays can be plain integers
+
+        /// Number of ticks (e.g., for indexing event lists by tick)
+        constexpr explicit operator std::uint64_t() const {
+            return value;
+        }
+
+        constexpr tick &operator+=(tick const &other) {
+            value = (value == infinite || other.value == infinite)? infinite : value + other.value;
+            return *this;
+        }
+
+        constexpr tick &operator-=(tick const &other) {
+            value = (value == infinite)? infinite : value - other.value;
+            return *this;
+        }
+
+        friend constexpr tick operator+(tick a, tick const &b) {
+            return a += b;
+        }
+
+        friend constexpr tick operator-(tick a, tick const &b) {
+            return a -= b;
+        }
+
+        friend constexpr bool operator==(tick const &a, tick const &b) {
+            return a.value == b.value;
+        }
+
+        friend constexpr bool operator!=(tick const &a, tick const &b) {
+            return a.value != b.value;
+        }
+
+        friend constexpr bool operator<(tick const &a, tick const &b) {
+            return a.value < b.value;
+        }
+
+        friend constexpr bool operator>(tick const &a, tick const &b) {
+            return a.value > b.value;
+        }
+
+        friend constexpr bool operator<=(tick const &a, tick const &b) {
+            return a.value <= b.value;
+        }
+
+        friend constexpr bool operator>=(tick const &a, tick const &b) {
+            return a.value >= b.value;
+        }
+
+        /// Ticks are printed as integers, so logs look like the ones of float time (e.g., "24")
+        friend std::ostream &operator<<(std::ostream &os, tick const &t) {
+            if (t.value == infinite) {
+                return os << "inf";
+            }
+            return os << t.value;
+        }
+    };
+} //namespace sim_engine
+
+/// Cadmium relies on numeric_limits to get the infinite time
+template <>
+class std::numeric_limits<sim_engine::tick> {
+public:
+    static constexpr bool is_specialized = true;
+    static constexpr bool is_signed = false;
+    static constexpr bool is_integer = true;
+    static constexpr bool is_exact = true;
+    static constexpr bool has_infinity = true;
+    static constexpr sim_engine::tick min() noexcept { return 0; }
+    static constexpr sim_engine::tick lowest() noexcept { return 0; }
+    static constexpr sim_engine::tick max() noexcept { return sim_engine::tick::infinite; }
+    static constexpr sim_engine::tick infinity() noexcept { return sim_engine::tick::infinite; }
+};
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_TICK_HPP
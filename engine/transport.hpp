@@ -0,0 +1,447 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_TRANSPORT_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_TRANSPORT_HPP
+
+#include <map>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+namespace sim_engine {
+    /**
+     * Point-to-point message transport between the processes (ranks) of a distributed simulation.
+     * Messages between two ranks are delivered in order.
+     */
+    class transport {
+    public:
+        virtual ~transport() = default;
+
+        /// @return rank of this process (from 0 to size() - 1)
+        [[nodiscard]] virtual std::size_t rank() const = 0;
+
+        /// @return number of processes in the distributed simulation
+        [[nodiscard]] virtual std::size_t size() const = 0;
+
+        /**
+         * Sends a message to another rank.
+         * @param to destination rank.
+         * @param msg message to be sent.
+         */
+        virtual void send(std::size_t to, std::vector<char> const &msg) = 0;
+
+        /**
+         * Receives the next message from another rank. It blocks until the message arrives.
+         * @param from source rank.
+         * @return received message.
+         */
+        virtual std::vector<char> receive(std::size_t from) = 0;
+
+        /**
+         * Sends a message to several ranks and receives one message from several ranks.
+         * By default, it sends all the messages before receiving any. Transports whose send blocks until the peer
+         * receives the message must override it, so two ranks that exchange big messages do not block each other.
+         * @param outbox destination ranks and messages to be sent.
+         * @param sources ranks to receive messages from.
+         * @return received messages, in the same order as sources.
+         */
+        virtual std::vector<std::vector<char>> exchange(std::vector<std::pair<std::size_t, std::vector<char>>> const &outbox,
+                                                        std::vector<std::size_t> const &sources) {
+            for (auto const &[to, msg]: outbox) {
+                send(to, msg);
+            }
+            std::vector<std::vector<char>> res;
+            for (auto from: sources) {
+                res.push_back(receive(from));
+            }
+            return res;
+        }
+    };
+
+    /**
+     * Transport over TCP sockets in the local host. Every rank listens in port base_port + rank, and connects to all
+     * the ranks with a lower rank. Messages are prefixed with their length.
+     * If a rank fails, its sockets are closed, and its peers fail as soon as they send or receive a message from it.
+     */
+    class socket_transport : public transport {
+        std::size_t my_rank;
+        std::vector<int> sockets;   /// socket connected to each rank (-1 for this rank)
+
+        /// Bytes of the messages that are being sent to a rank
+        struct outgoing_bytes {
+            std::vector<char> bytes;    /// length prefix and content of every message, back to back
+            std::size_t sent = 0;       /// number of bytes already sent
+        };
+
+        /// Messages that are being received from a rank
+        struct incoming_bytes {
+            std::vector<std::size_t> slots;     /// index of every expected message in the result of exchange
+            std::size_t next = 0;               /// number of messages already received
+            uint64_t length = 0;                /// length of the message being received
+            std::size_t received = 0;           /// number of bytes of the length prefix and the message received
+        };
+
+        static void write_all(int fd, char const *data, std::size_t n) {
+            while (n > 0) {
+                auto written = ::send(fd, data, n, MSG_NOSIGNAL);
+                if (written < 0) {
+                    throw std::system_error(errno, std::generic_category(), "socket_transport: unable to send");
+                }
+                data += written;
+                n -= written;
+            }
+        }
+
+        static void read_all(int fd, char *data, std::size_t n) {
+            while (n > 0) {
+                auto read = ::recv(fd, data, n, 0);
+                if (read < 0) {
+                    throw std::system_error(errno, std::generic_category(), "socket_transport: unable to receive");
+                }
+                if (read == 0) {
+                    throw std::runtime_error("socket_transport: connection closed by a peer");
+                }
+                data += read;
+                n -= read;
+            }
+        }
+
+        static sockaddr_in address(int port) {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            return addr;
+        }
+
+        /// @return a new TCP socket
+        static int new_socket() {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(), "socket_transport: unable to create a socket");
+            }
+            return fd;
+        }
+
+        /// Closes the sockets of all the ranks.
+        void close_all() {
+            for (auto &fd: sockets) {
+                if (fd >= 0) {
+                    ::close(fd);
+                    fd = -1;
+                }
+            }
+        }
+
+        /**
+         * Connects this rank to all the other ranks.
+         * @param listener socket that listens in the port of this rank.
+         * @param base_port port of rank 0.
+         * @param deadline time at which connecting to the other ranks is given up.
+         */
+        void connect_all(int listener, int base_port, std::chrono::steady_clock::time_point deadline) {
+            int yes = 1;
+            for (std::size_t peer = 0; peer < my_rank; ++peer) {
+                auto peer_addr = address(base_port + (int) peer);
+                while (true) {
+                    sockets[peer] = new_socket();
+                    if (::connect(sockets[peer], (sockaddr *) &peer_addr, sizeof(peer_addr)) == 0) {
+                        break;
+                    }
+                    int error = errno;
+                    ::close(sockets[peer]);
+                    sockets[peer] = -1;
+                    if (std::chrono::steady_clock::now() > deadline) {
+                        throw std::system_error(error, std::generic_category(),
+                                                "socket_transport: unable to connect to rank " + std::to_string(peer));
+                    }
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+                auto me = (uint64_t) my_rank;
+                write_all(sockets[peer], (char const *) &me, sizeof(me));
+            }
+            for (std::size_t i = my_rank + 1; i < sockets.size(); ++i) {
+                auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                pollfd ready{listener, POLLIN, 0};
+                int n_ready = ::poll(&ready, 1, (int) std::max<long>(0, (long) remaining.count()));
+                if (n_ready < 0) {
+                    throw std::system_error(errno, std::generic_category(), "socket_transport: unable to wait for ranks");
+                }
+                if (n_ready == 0) {
+                    throw std::runtime_error("socket_transport: timed out waiting for the ranks after " + std::to_string(my_rank));
+                }
+                int fd = ::accept(listener, nullptr, nullptr);
+                if (fd < 0) {
+                    throw std::system_error(errno, std::generic_category(), "socket_transport: unable to accept a rank");
+                }
+                uint64_t peer;
+                try {
+                    read_all(fd, (char *) &peer, sizeof(peer));
+                } catch (...) {
+                    ::close(fd);
+                    throw;
+                }
+                if (peer <= my_rank || peer >= sockets.size() || sockets[peer] >= 0) {
+                    ::close(fd);
+                    throw std::runtime_error("socket_transport: unexpected connection from rank " + std::to_string(peer));
+                }
+                sockets[peer] = fd;
+            }
+            for (auto fd: sockets) {
+                if (fd >= 0) {
+                    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+                }
+            }
+        }
+    public:
+        /**
+         * Connects all the ranks of a distributed simulation. It blocks until this rank is connected to every rank.
+         * @param rank rank of this process.
+         * @param n_ranks number of processes in the distributed simulation.
+         * @param base_port port of rank 0. Rank i listens in port base_port + i.
+         * @param timeout maximum time to wait for other ranks to be ready.
+         * @throw std::system_error if a socket operation fails, or std::runtime_error if some rank is not ready in time.
+         */
+        socket_transport(std::size_t rank, std::size_t n_ranks, int base_port,
+                         std::chrono::seconds timeout = std::chrono::seconds(30)) : my_rank(rank), sockets(n_ranks, -1) {
+            int listener = new_socket();
+            int yes = 1;
+            ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+            auto addr = address(base_port + (int) rank);
+            if (::bind(listener, (sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(listener, (int) n_ranks) != 0) {
+                int error = errno;
+                ::close(listener);
+                throw std::system_error(error, std::generic_category(),
+                                        "socket_transport: unable to listen in port " + std::to_string(base_port + rank));
+            }
+            try {
+                connect_all(listener, base_port, std::chrono::steady_clock::now() + timeout);
+            } catch (...) {
+                ::close(listener);
+                close_all();  // peers find out that this rank failed
+                throw;
+            }
+            ::close(listener);
+        }
+
+        socket_transport(socket_transport const &) = delete;
+        socket_transport &operator=(socket_transport const &) = delete;
+
+        ~socket_transport() override {
+            close_all();
+        }
+
+        [[nodiscard]] std::size_t rank() const override {
+            return my_rank;
+        }
+
+        [[nodiscard]] std::size_t size() const override {
+            return sockets.size();
+        }
+
+        void send(std::size_t to, std::vector<char> const &msg) override {
+            auto n = (uint64_t) msg.size();
+            write_all(sockets.at(to), (char const *) &n, sizeof(n));
+            write_all(sockets.at(to), msg.data(), msg.size());
+        }
+
+        std::vector<char> receive(std::size_t from) override {
+            uint64_t n;
+            read_all(sockets.at(from), (char *) &n, sizeof(n));
+            std::vector<char> res(n);
+            read_all(sockets.at(from), res.data(), n);
+            return res;
+        }
+
+        /**
+         * Sends and receives all the messages at once in the calling thread. It waits for any socket to be ready with
+         * poll, and then sends or receives as many bytes as the socket accepts without blocking.
+         * @throw std::system_error if a socket operation fails, or std::runtime_error if a peer closed its connection.
+         */
+        std::vector<std::vector<char>> exchange(std::vector<std::pair<std::size_t, std::vector<char>>> const &outbox,
+                                                std::vector<std::size_t> const &sources) override {
+            std::map<int, outgoing_bytes> outgoing;
+            for (auto const &[to, msg]: outbox) {
+                auto &out = outgoing[sockets.at(to)].bytes;
+                auto n = (uint64_t) msg.size();
+                out.insert(out.end(), (char const *) &n, (char const *) &n + sizeof(n));
+                out.insert(out.end(), msg.begin(), msg.end());
+            }
+            std::map<int, incoming_bytes> incoming;
+            for (std::size_t k = 0; k < sources.size(); ++k) {
+                incoming[sockets.at(sources[k])].slots.push_back(k);
+            }
+            std::vector<std::vector<char>> res(sources.size());
+            std::vector<pollfd> ready;
+            while (!outgoing.empty() || !incoming.empty()) {
+                ready.clear();
+                for (auto const &entry: outgoing) {
+                    ready.push_back({entry.first, POLLOUT, 0});
+                }
+                auto n_sending = ready.size();
+                for (auto const &entry: incoming) {
+                    ready.push_back({entry.first, POLLIN, 0});
+                }
+                if (::poll(ready.data(), ready.size(), -1) < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "socket_transport: unable to wait for peers");
+                }
+                for (std::size_t k = 0; k < ready.size(); ++k) {
+                    if (ready[k].revents != 0 && k < n_sending) {
+                        send_some(ready[k].fd, outgoing);
+                    } else if (ready[k].revents != 0) {
+                        receive_some(ready[k].fd, incoming, res);
+                    }
+                }
+            }
+            return res;
+        }
+    private:
+        /// Sends as many bytes as a ready socket accepts, and forgets the socket once all its bytes are sent.
+        static void send_some(int fd, std::map<int, outgoing_bytes> &outgoing) {
+            auto &out = outgoing.at(fd);
+            auto written = ::send(fd, out.bytes.data() + out.sent, out.bytes.size() - out.sent, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if (written < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                throw std::system_error(errno, std::generic_category(), "socket_transport: unable to send");
+            }
+            out.sent += written;
+            if (out.sent == out.bytes.size()) {
+                outgoing.erase(fd);
+            }
+        }
+
+        /// Receives as many bytes as a ready socket has, and forgets the socket once all its messages are received.
+        static void receive_some(int fd, std::map<int, incoming_bytes> &incoming, std::vector<std::vector<char>> &res) {
+            auto &in = incoming.at(fd);
+            auto &msg = res[in.slots[in.next]];
+            bool prefix = in.received < sizeof(in.length);  // the length of the message is not complete yet
+            char *data = prefix? (char *) &in.length + in.received : msg.data() + (in.received - sizeof(in.length));
+            std::size_t missing = prefix? sizeof(in.length) - in.received : sizeof(in.length) + in.length - in.received;
+            auto read = ::recv(fd, data, missing, MSG_DONTWAIT);
+            if (read < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return;
+                }
+                throw std::system_error(errno, std::generic_category(), "socket_transport: unable to receive");
+            }
+            if (read == 0) {
+                throw std::runtime_error("socket_transport: connection closed by a peer");
+            }
+            in.received += read;
+            if (prefix && in.received == sizeof(in.length)) {
+                msg.resize(in.length);
+            }
+            if (in.received == sizeof(in.length) + in.length) {
+                in.received = 0;
+                in.length = 0;
+                if (++in.next == in.slots.size()) {
+                    incoming.erase(fd);
+                }
+            }
+        }
+    };
+
+    /// @return process IDs of the child processes created by spawn_ranks that did not finish yet
+    std::vector<pid_t> &rank_processes() {
+        static std::vector<pid_t> res;
+        return res;
+    }
+
+    /**
+     * Forks the current process into a group of processes that take part in a distributed simulation.
+     * It must be called before creating any thread.
+     * @param n_ranks number of processes (including the current one, that becomes rank 0).
+     * @return rank of the calling process.
+     * @throw std::runtime_error if a process could not be created.
+     */
+    std::size_t spawn_ranks(std::size_t n_ranks) {
+        for (std::size_t rank = 1; rank < n_ranks; ++rank) {
+            auto pid = ::fork();
+            if (pid < 0) {
+                throw std::runtime_error("unable to create process for rank " + std::to_string(rank));
+            }
+            if (pid == 0) {
+                rank_processes().clear();
+                return rank;
+            }
+            rank_processes().push_back(pid);
+        }
+        return 0;
+    }
+
+    /**
+     * Waits until all the child processes created by spawn_ranks finish. As soon as one of them fails, the rest are
+     * killed, as they would otherwise wait forever for the messages of the failed one.
+     * @param failed true if rank 0 failed (all the child processes are killed right away).
+     * @return true if rank 0 and all the child processes finished successfully.
+     */
+    bool wait_ranks(bool failed = false) {
+        auto &running = rank_processes();
+        bool res = !failed;
+        while (!running.empty()) {
+            if (!res) {
+                for (auto pid: running) {
+                    ::kill(pid, SIGTERM);
+                }
+            }
+            int status;
+            auto pid = ::waitpid(-1, &status, 0);
+            if (pid < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            running.erase(std::remove(running.begin(), running.end(), pid), running.end());
+            res &= WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        }
+        return res;
+    }
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_TRANSPORT_HPP
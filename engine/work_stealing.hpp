@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef CELLDEVS_TUTORIAL_ENGINE_WORK_STEALING_HPP
+#define CELLDEVS_TUTORIAL_ENGINE_WORK_STEALING_HPP
+
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <utility>
+#include <functional>
+#include "thread_pool.hpp"
+
+namespace sim_engine {
+    /// Range of cells [first, second) evaluated as a single task
+    using cell_range = std::pair<std::size_t, std::size_t>;
+
+    /**
+     * Splits a sequence of cells in contiguous ranges with roughly the same number of edges.
+     * Every cell weighs its number of neighbors plus one, so a hub cell with thousands of neighbors ends up in a
+     * range of its own while thousands of cells with a handful of neighbors share another one.
+     * @tparam N type of the neighbor lists (e.g., adjacency).
+     * @param neighbors neighbor list of every cell.
+     * @param cells indices of the cells to be split. Ranges refer to positions in this sequence.
+     * @param n_ranges desired number of ranges.
+     * @return contiguous ranges of the sequence that cover it completely.
+     */
+    template <typename N>
+    std::vector<cell_range> partition_by_edges(N const &neighbors, std::vector<std::size_t> const &cells,
+                                               std::size_t n_ranges) {
+        std::size_t total = 0;
+        for (auto i: cells) {
+            total += neighbors[i].size() + 1;
+        }
+        std::vector<cell_range> res;
+        std::size_t from = 0, acc = 0;
+        for (std::size_t k = 0; k < cells.size(); ++k) {
+            acc += neighbors[cells[k]].size() + 1;
+            if (acc * n_ranges >= total * (res.size() + 1)) {
+                res.emplace_back(from, k + 1);
+                from = k + 1;
+            }
+        }
+        if (from < cells.size()) {
+            res.emplace_back(from, cells.size());
+        }
+        return res;
+    }
+
+    /**
+     * Work-stealing executor for sets of independent tasks with uneven costs.
+     * Tasks are dealt in contiguous blocks to one deque per thread. Every thread pops tasks from the front of its own
+     * deque and, once it is empty, steals tasks from the back of the other deques. The k-th deque always belongs to
+     * the k-th thread of the pool, so runs with the same number of tasks give every thread the same tasks (but the
+     * stolen ones).
+     */
+    class work_stealing {
+        /// Deque of pending tasks owned by one thread
+        struct owner {
+            std::mutex mutex;
+            std::deque<std::size_t> tasks;
+        };
+
+        thread_pool &pool;
+        std::vector<owner> owners;
+
+        bool pop(std::size_t o, std::size_t &task) {
+            std::lock_guard<std::mutex> lock(owners[o].mutex);
+            if (owners[o].tasks.empty()) {
+                return false;
+            }
+            task = owners[o].tasks.front();
+            owners[o].tasks.pop_front();
+            return true;
+        }
+
+        bool steal(std::size_t thief, std::size_t &task) {
+            for (std::size_t k = 1; k < owners.size(); ++k) {
+                auto &victim = owners[(thief + k) % owners.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty()) {
+                    task = victim.tasks.back();
+                    victim.tasks.pop_back();
+                    return true;
+                }
+            }
+            return false;
+        }
+    public:
+        explicit work_stealing(thread_pool &pool) : pool(pool), owners(pool.size()) {}
+
+        /**
+         * @param task index of a task.
+         * @param n_tasks number of tasks.
+         * @param n_threads number of threads of the pool.
+         * @return index of the thread whose deque gets the task.
+         */
+        static std::size_t owner_of(std::size_t task, std::size_t n_tasks, std::size_t n_threads) {
+            return task * n_threads / n_tasks;
+        }
+
+        /**
+         * Executes task(0), ..., task(n_tasks - 1) in parallel and waits until all of them have finished.
+         * @param n_tasks number of tasks. They are dealt to the threads in contiguous blocks.
+         * @param f function that executes a task.
+         */
+        void run(std::size_t n_tasks, std::function<void(std::size_t)> const &f) {
+            for (std::size_t t = 0; t < n_tasks; ++t) {
+                owners[owner_of(t, n_tasks, owners.size())].tasks.push_back(t);
+            }
+            pool.on_each_thread([&](std::size_t o) {
+                std::size_t task;
+                while (pop(o, task) || steal(o, task)) {
+                    f(task);
+                }
+            });
+        }
+    };
+} //namespace sim_engine
+
+#endif //CELLDEVS_TUTORIAL_ENGINE_WORK_STEALING_HPP
@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2020, Román Cárdenas Rodríguez
+ * ARSLab - Carleton University
+ * GreenLSI - Polytechnic University of Madrid
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "engine/conservative_runner.hpp"
+#include "1_4_spatial_sirds/model/cells/sirds_cell.hpp"
+
+using namespace std;
+
+/// sirds_adaptive_kernel that checks the error bound of every output delay that it chooses
+struct checked_kernel : sirds_adaptive_kernel {
+    static inline size_t held = 0;          /// new states published after more than one tick
+    static inline size_t violations = 0;    /// held states whose drift exceeds the error bound
+
+    static int output_delay(sird const &published, sird const &c_state, sirds_adaptive_config const &config) {
+        int d = sirds_adaptive_kernel::output_delay(published, c_state, config);
+        if (d > 1) {
+            held++;
+            float drift = (float) d * std::abs(c_state.infected - published.infected);
+            if (drift > config.tolerance * std::max(published.infected, quantum) * 1.00001f) {
+                violations++;
+            }
+        }
+        return d;
+    }
+};
+
+/**
+ * @param scenario scenario of the 1_4_spatial_sirds tutorial.
+ * @param sim_time maximum simulation time.
+ * @param tolerance tolerance of every cell.
+ * @param max_delay maximum output delay of every cell.
+ * @return state log of the conservative runner with adaptive output delays.
+ */
+string adaptive_log(nlohmann::json const &scenario, float sim_time, float tolerance, int max_delay) {
+    auto lattice = sim_engine::lattice<checked_kernel>::from_json(scenario);
+    for (auto &config: lattice.configs) {
+        config.tolerance = tolerance;
+        config.max_delay = max_delay;
+    }
+    ostringstream log;
+    sim_engine::conservative_runner<float, checked_kernel> r(std::move(lattice), log, 1);
+    r.run_until(sim_time);
+    return log.str();
+}
+
+/**
+ * Checks the error bound of sirds_adaptive_kernel (see its documentation): with a tolerance of 0, the simulation must
+ * be the same as the one of sirds_kernel, and with the given tolerance, no held state may drift further than allowed.
+ */
+int main(int argc, char ** argv) {
+    if (argc != 5) {
+        cout << "Program used with wrong parameters. The program must be invoked as follows:";
+        cout << argv[0] << " SCENARIO_CONFIG.json MAX_SIMULATION_TIME TOLERANCE MAX_DELAY" << endl;
+        return -1;
+    }
+    auto scenario = sim_engine::read_json(argv[1]);
+    float sim_time = stof(argv[2]);
+
+    ostringstream fixed;
+    sim_engine::conservative_runner<float, sirds_kernel> r(sim_engine::lattice<sirds_kernel>::from_json(scenario), fixed, 1);
+    r.run_until(sim_time);
+    if (adaptive_log(scenario, sim_time, 0, stoi(argv[4])) != fixed.str() || checked_kernel::held > 0) {
+        cout << "With a tolerance of 0, the state log differs from the one of sirds_kernel" << endl;
+        return -1;
+    }
+    adaptive_log(scenario, sim_time, stof(argv[3]), stoi(argv[4]));
+    cout << checked_kernel::held << " held states, " << checked_kernel::violations << " beyond the error bound" << endl;
+    return (checked_kernel::held > 0 && checked_kernel::violations == 0)? 0 : -1;
+}
@@ -0,0 +1,50 @@
+# Interrupts a run of a tutorial executable with checkpoints, resumes it from the checkpoint, and checks that the state
+# log is the same as the one of the run without interruptions. It is run by CTest (see CMakeLists.txt):
+#
+#   cmake -DEXECUTABLE=<path> -DSCENARIO=<path> -DSIM_TIME=<time> -DINTERRUPT=<time> -DEVERY=<time> -DSTATE_LOG=<path>
+#         -DWORKING_DIRECTORY=<path> -DOUTPUT_DIR=<path> [-DFLAGS=<flags>] -P checkpoint_restore.cmake
+#
+# The interrupted run stops at INTERRUPT and writes a checkpoint every EVERY time units. It is resumed twice from its
+# last checkpoint: the second time, the state log is longer than when the checkpoint was written, so it must be cut
+# back. Every run uses FLAGS (e.g., the schedule or the termination predicates). Logs are kept in OUTPUT_DIR.
+
+foreach(var EXECUTABLE SCENARIO SIM_TIME INTERRUPT EVERY STATE_LOG WORKING_DIRECTORY OUTPUT_DIR)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not defined")
+    endif()
+endforeach()
+
+file(REMOVE_RECURSE ${OUTPUT_DIR})
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+
+# Runs the executable until the given time with the given flags and copies its state log to the given file
+function(run_until time args copy)
+    execute_process(COMMAND ${EXECUTABLE} ${SCENARIO} ${time} ${flags} ${args}
+            WORKING_DIRECTORY ${WORKING_DIRECTORY} RESULT_VARIABLE result OUTPUT_QUIET)
+    if(NOT result EQUAL 0 OR NOT EXISTS ${STATE_LOG})
+        message(FATAL_ERROR "${EXECUTABLE} ${time} ${FLAGS} ${args} failed (${result})")
+    endif()
+    configure_file(${STATE_LOG} ${copy} COPYONLY)
+endfunction()
+
+# Checks that the given state log is the same as the one of the run without interruptions
+function(check_log copy)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIR}/reference.txt ${copy} RESULT_VARIABLE different)
+    if(different)
+        message(FATAL_ERROR "the state log of the resumed run differs from the reference (see ${copy})")
+    endif()
+endfunction()
+
+file(REMOVE ${STATE_LOG})
+run_until(${SIM_TIME} "" ${OUTPUT_DIR}/reference.txt)
+file(REMOVE ${STATE_LOG})
+set(checkpoint ${OUTPUT_DIR}/checkpoint.bin)
+run_until(${INTERRUPT} "--checkpoint;${checkpoint};--checkpoint-every;${EVERY}" ${OUTPUT_DIR}/interrupted.txt)
+configure_file(${checkpoint} ${OUTPUT_DIR}/interrupted.bin COPYONLY)
+run_until(${SIM_TIME} "--restore;${OUTPUT_DIR}/interrupted.bin;--checkpoint;${checkpoint};--checkpoint-every;${EVERY}"
+        ${OUTPUT_DIR}/resumed.txt)
+check_log(${OUTPUT_DIR}/resumed.txt)
+run_until(${SIM_TIME} "--restore;${OUTPUT_DIR}/interrupted.bin" ${OUTPUT_DIR}/resumed_again.txt)
+check_log(${OUTPUT_DIR}/resumed_again.txt)
+message(STATUS "same state log as the run without interruptions")
@@ -0,0 +1,84 @@
+# Runs a tutorial executable with the flags of some alternative execution modes, and checks that every mode writes the
+# same state logs as the reference run (by default, the Cadmium runner). It is run by CTest (see CMakeLists.txt):
+#
+#   cmake -DEXECUTABLE=<path> -DSCENARIO=<path> -DSIM_TIME=<time> -DSTATE_LOG=<path> -DWORKING_DIRECTORY=<path>
+#         -DOUTPUT_DIR=<path> "-DMODES=--dense|--threads 3|..." [-DREFERENCE=<flags>]
+#         [-DREFERENCE_EXECUTABLE=<path>] [-DARGUMENTS=<path>] [-DSTOPS_EARLY=ON] -P compare_modes.cmake
+#
+# Modes are separated by "|" (an empty mode runs the executable without flags). STATE_LOG may be a glob pattern (e.g.,
+# for the state logs of the runs of an ensemble). ARGUMENTS go before the scenario (e.g., the parameter sweep of an
+# ensemble). The reference run uses REFERENCE_EXECUTABLE if given. With STOPS_EARLY, modes must stop before SIM_TIME
+# (e.g., with --stop-below): every state log of the first mode must be a strict prefix of the reference one, and the
+# rest of the modes must write the same state logs as the first one. The state logs of every mode are kept in
+# OUTPUT_DIR, which is emptied first.
+
+foreach(var EXECUTABLE SCENARIO SIM_TIME STATE_LOG WORKING_DIRECTORY OUTPUT_DIR MODES)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not defined")
+    endif()
+endforeach()
+if(NOT DEFINED REFERENCE_EXECUTABLE)
+    set(REFERENCE_EXECUTABLE ${EXECUTABLE})
+endif()
+
+file(REMOVE_RECURSE ${OUTPUT_DIR})
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+
+# Runs an executable with the given flags and copies its state logs to the given directory
+function(run_mode executable flags copy)
+    separate_arguments(args UNIX_COMMAND "${flags}")
+    file(GLOB logs ${STATE_LOG})
+    if(logs)
+        file(REMOVE ${logs})
+    endif()
+    execute_process(COMMAND ${executable} ${ARGUMENTS} ${SCENARIO} ${SIM_TIME} ${args}
+            WORKING_DIRECTORY ${WORKING_DIRECTORY} RESULT_VARIABLE result OUTPUT_QUIET)
+    file(GLOB logs ${STATE_LOG})
+    if(NOT result EQUAL 0 OR NOT logs)
+        message(FATAL_ERROR "${executable} ${flags} failed (${result})")
+    endif()
+    file(COPY ${logs} DESTINATION ${copy})
+endfunction()
+
+run_mode(${REFERENCE_EXECUTABLE} "${REFERENCE}" ${OUTPUT_DIR}/reference)
+file(GLOB references RELATIVE ${OUTPUT_DIR}/reference ${OUTPUT_DIR}/reference/*)
+set(expected ${OUTPUT_DIR}/reference)
+string(REPLACE "|" ";" modes "${MODES}")
+set(failed "")
+set(k 0)
+foreach(mode IN LISTS modes)
+    math(EXPR k "${k} + 1")
+    run_mode(${EXECUTABLE} "${mode}" ${OUTPUT_DIR}/mode_${k})
+    file(GLOB logs RELATIVE ${OUTPUT_DIR}/mode_${k} ${OUTPUT_DIR}/mode_${k}/*)
+    if("${logs}" STREQUAL "${references}")
+        set(different 0)
+    else()
+        set(different 1)  # a mode wrote other state logs than the reference
+    endif()
+    foreach(log IN LISTS references)
+        if(different)
+        elseif(STOPS_EARLY AND k EQUAL 1)
+            file(READ ${OUTPUT_DIR}/reference/${log} full)
+            file(READ ${OUTPUT_DIR}/mode_${k}/${log} stopped)
+            string(FIND "${full}" "${stopped}" position)
+            if(NOT position EQUAL 0 OR full STREQUAL stopped)
+                set(different 1)
+            endif()
+        else()
+            execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${expected}/${log} ${OUTPUT_DIR}/mode_${k}/${log}
+                    RESULT_VARIABLE different)
+        endif()
+    endforeach()
+    if(different)
+        message(STATUS "${mode}: the state logs differ from the expected ones (see ${OUTPUT_DIR}/mode_${k})")
+        list(APPEND failed "${mode}")
+    else()
+        message(STATUS "${mode}: same state logs as the expected ones")
+    endif()
+    if(STOPS_EARLY)
+        set(expected ${OUTPUT_DIR}/mode_1)
+    endif()
+endforeach()
+if(failed)
+    message(FATAL_ERROR "modes with different state logs: ${failed}")
+endif()
@@ -0,0 +1,44 @@
+# Forks a run into policy branches, and checks that the prefix followed by the branch of the first variant (which must
+# not change anything) is the same state log as a run without branches. It is run by CTest (see CMakeLists.txt):
+#
+#   cmake -DEXECUTABLE=<branches executable> -DRUNNER=<executable> -DVARIANTS=<path> -DSCENARIO=<path> -DSIM_TIME=<time>
+#         -DFORK_AT=<time> -DLOG_DIR=<path> -DNAME=<executable name> -DWORKING_DIRECTORY=<path> -DOUTPUT_DIR=<path>
+#         [-DFLAGS=<flags>] -P fork_branches.cmake
+#
+# RUNNER runs the scenario without branches, with FLAGS. Its state log and the ones of the prefix and the branches are
+# in LOG_DIR, named after NAME. The state logs are kept in OUTPUT_DIR, which is emptied first.
+
+foreach(var EXECUTABLE RUNNER VARIANTS SCENARIO SIM_TIME FORK_AT LOG_DIR NAME WORKING_DIRECTORY OUTPUT_DIR)
+    if(NOT DEFINED ${var})
+        message(FATAL_ERROR "${var} is not defined")
+    endif()
+endforeach()
+
+file(REMOVE_RECURSE ${OUTPUT_DIR})
+file(MAKE_DIRECTORY ${OUTPUT_DIR})
+separate_arguments(flags UNIX_COMMAND "${FLAGS}")
+
+file(REMOVE ${LOG_DIR}/${NAME}_state.txt)
+execute_process(COMMAND ${RUNNER} ${SCENARIO} ${SIM_TIME} ${flags}
+        WORKING_DIRECTORY ${WORKING_DIRECTORY} RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0 OR NOT EXISTS ${LOG_DIR}/${NAME}_state.txt)
+    message(FATAL_ERROR "${RUNNER} ${FLAGS} failed (${result})")
+endif()
+configure_file(${LOG_DIR}/${NAME}_state.txt ${OUTPUT_DIR}/reference.txt COPYONLY)
+
+file(REMOVE ${LOG_DIR}/${NAME}_prefix.txt ${LOG_DIR}/${NAME}_branch_0.txt)
+execute_process(COMMAND ${EXECUTABLE} ${VARIANTS} ${SCENARIO} ${SIM_TIME} --fork-at ${FORK_AT}
+        WORKING_DIRECTORY ${WORKING_DIRECTORY} RESULT_VARIABLE result OUTPUT_QUIET)
+if(NOT result EQUAL 0 OR NOT EXISTS ${LOG_DIR}/${NAME}_prefix.txt OR NOT EXISTS ${LOG_DIR}/${NAME}_branch_0.txt)
+    message(FATAL_ERROR "${EXECUTABLE} --fork-at ${FORK_AT} failed (${result})")
+endif()
+file(READ ${LOG_DIR}/${NAME}_prefix.txt prefix)
+file(READ ${LOG_DIR}/${NAME}_branch_0.txt branch)
+file(WRITE ${OUTPUT_DIR}/branch_0.txt "${prefix}${branch}")
+
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${OUTPUT_DIR}/reference.txt ${OUTPUT_DIR}/branch_0.txt
+        RESULT_VARIABLE different)
+if(different)
+    message(FATAL_ERROR "the prefix and the first branch differ from the run without branches (see ${OUTPUT_DIR})")
+endif()
+message(STATUS "the prefix and the first branch are the same as the run without branches")